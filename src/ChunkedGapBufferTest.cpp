@@ -0,0 +1,283 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "chunked_gapbuffer.h"
+using namespace ::testing;
+
+// tiny chunks so every test crosses chunk boundaries
+using SmallChunks = ChunkedGapBuffer<char, std::allocator<char>, 8>;
+
+class ChunkedGapBufferTest : public Test {
+public:
+};
+
+TEST_F(ChunkedGapBufferTest, DefaultConstructor) {
+    SmallChunks cb;
+
+    EXPECT_EQ(cb.size(), 0);
+    EXPECT_TRUE(cb.empty());
+    EXPECT_EQ(cb.begin(), cb.end());
+    EXPECT_EQ(cb.to_string(), "");
+}
+
+TEST_F(ChunkedGapBufferTest, StringViewConstructor) {
+    SmallChunks cb(std::string_view("hello chunked world"));
+
+    EXPECT_EQ(cb.size(), 19);
+    EXPECT_EQ(cb.chunk_count(), 3);
+    EXPECT_EQ(cb.to_string(), "hello chunked world");
+}
+
+TEST_F(ChunkedGapBufferTest, At) {
+    SmallChunks cb(std::string_view("hello chunked world"));
+
+    EXPECT_EQ(cb.at(0), 'h');
+    EXPECT_EQ(cb.at(8), 'u');
+    EXPECT_EQ(cb.at(18), 'd');
+    EXPECT_THROW(cb.at(19), std::out_of_range);
+}
+
+TEST_F(ChunkedGapBufferTest, IteratorsCrossChunks) {
+    const std::string s = "hello chunked world";
+    SmallChunks cb(s);
+
+    EXPECT_EQ(std::string(cb.begin(), cb.end()), s);
+    EXPECT_EQ(std::string(cb.rbegin(), cb.rend()),
+              std::string(s.rbegin(), s.rend()));
+    EXPECT_EQ(cb.end() - cb.begin(), 19);
+    EXPECT_EQ(*(cb.begin() + 8), 'u');
+    EXPECT_EQ(*(cb.end() - 3), 'r');
+}
+
+TEST_F(ChunkedGapBufferTest, InsertSplitsFullChunk) {
+    SmallChunks cb(std::string_view("abcdefgh"));
+    ASSERT_EQ(cb.chunk_count(), 1);
+
+    cb.insert(cb.begin() + 4, std::string_view("0123456789"));
+
+    EXPECT_EQ(cb.to_string(), "abcd0123456789efgh");
+    EXPECT_EQ(cb.size(), 18);
+    EXPECT_GE(cb.chunk_count(), 3);
+}
+
+TEST_F(ChunkedGapBufferTest, PushBack) {
+    SmallChunks cb;
+    std::string expected;
+    for (int i = 0; i < 100; ++i) {
+        cb.push_back("Abc"[i % 3]);
+        expected += "Abc"[i % 3];
+    }
+
+    EXPECT_EQ(cb.to_string(), expected);
+    EXPECT_EQ(cb.chunk_count(), 13);
+}
+
+TEST_F(ChunkedGapBufferTest, EraseAcrossChunks) {
+    SmallChunks cb(std::string_view("0123456789abcdefghijklmnopqrstuv"));
+    cb.erase(cb.begin() + 5, cb.begin() + 27);
+
+    EXPECT_EQ(cb.to_string(), "01234rstuv");
+    EXPECT_EQ(cb.chunk_count(), 2);
+
+    cb.erase(cb.begin(), cb.end());
+    EXPECT_TRUE(cb.empty());
+}
+
+TEST_F(ChunkedGapBufferTest, MatchesStringUnderRandomEdits) {
+    std::mt19937 rng(7);
+    SmallChunks cb;
+    std::string expected;
+    for (int i = 0; i < 2000; ++i) {
+        const size_t pos = expected.empty() ? 0 : rng() % expected.size();
+        if (rng() % 3 == 0 && !expected.empty()) {
+            const size_t n = std::min<size_t>(rng() % 20, expected.size() - pos);
+            cb.erase(cb.begin() + pos, n);
+            expected.erase(pos, n);
+        } else {
+            const std::string text(rng() % 12, static_cast<char>('a' + i % 26));
+            cb.insert(cb.begin() + pos, std::string_view(text));
+            expected.insert(pos, text);
+        }
+        ASSERT_EQ(cb.size(), expected.size());
+    }
+
+    EXPECT_EQ(cb.to_string(), expected);
+    for (size_t i = 0; i < expected.size(); i += 37) {
+        EXPECT_EQ(cb.at(i), expected[i]);
+    }
+}
+
+TEST_F(ChunkedGapBufferTest, SnapshotIsUnaffectedByLaterEdits) {
+    SmallChunks cb(std::string_view("0123456789abcdefghijklmnopqrstuv"));
+    const SmallChunks::snapshot_type snap = cb.snapshot();
+
+    cb.insert(cb.begin() + 3, std::string_view("___"));
+    cb.erase(cb.begin() + 20, 8);
+    cb.at(0) = '#';
+
+    EXPECT_EQ(snap->to_string(), "0123456789abcdefghijklmnopqrstuv");
+    EXPECT_EQ(snap->at(0), '0');
+    EXPECT_EQ(cb.to_string(), "#12___3456789abcdefgpqrstuv");
+
+    // copies share chunks until they are written to
+    SmallChunks copy = cb;
+    copy.push_back('!');
+    EXPECT_EQ(cb.to_string(), "#12___3456789abcdefgpqrstuv");
+    EXPECT_EQ(copy.to_string(), "#12___3456789abcdefgpqrstuv!");
+}
+
+TEST_F(ChunkedGapBufferTest, SnapshotReadersRunWhileWriterEdits) {
+    std::string text;
+    for (int i = 0; i < 4000; ++i) {
+        text += "line " + std::to_string(i) + "\n";
+    }
+    ChunkedGapBuffer<char, std::allocator<char>, 256> cb(text);
+    const auto snap = cb.snapshot();
+
+    std::vector<std::thread> readers;
+    std::vector<std::string> seen(4);
+    for (size_t r = 0; r < seen.size(); ++r) {
+        readers.emplace_back([&, r] {
+            for (int pass = 0; pass < 5; ++pass) {
+                seen[r].assign(snap->begin(), snap->end());
+            }
+        });
+    }
+    std::mt19937 rng(1);
+    for (int i = 0; i < 2000; ++i) {
+        const size_t pos = rng() % cb.size();
+        if (i % 2 == 0) {
+            cb.insert(cb.begin() + pos, std::string_view("edit"));
+        } else {
+            cb.erase(cb.begin() + pos, std::min<size_t>(5, cb.size() - pos));
+        }
+    }
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+
+    for (const std::string& s : seen) {
+        EXPECT_EQ(s, text);
+    }
+    const std::string needle = "line 3999\n";
+    EXPECT_EQ(std::search(snap->begin(), snap->end(), needle.begin(),
+                          needle.end()) -
+                  snap->begin(),
+              static_cast<std::ptrdiff_t>(text.size() - needle.size()));
+}
+
+// memory resource counting the bytes it currently hands out
+class CountingResource : public std::pmr::memory_resource {
+public:
+    long live = 0;
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t align) override {
+        live += bytes;
+        return std::pmr::new_delete_resource()->allocate(bytes, align);
+    }
+
+    void do_deallocate(void* p, std::size_t bytes,
+                       std::size_t align) override {
+        live -= bytes;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+    }
+
+    bool do_is_equal(const memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+TEST_F(ChunkedGapBufferTest, ChunksUseTheBufferAllocator) {
+    using PmrChunks =
+        ChunkedGapBuffer<char, std::pmr::polymorphic_allocator<char>, 8>;
+    CountingResource resource;
+    {
+        PmrChunks cb(std::string_view("0123456789abcdefghij"), &resource);
+        EXPECT_GT(resource.live, 20);
+        cb.insert(cb.begin() + 4, std::string_view("inserted text"));
+        cb.erase(cb.begin() + 10, 12);
+        const auto snap = cb.snapshot();
+        cb.at(0) = '#'; // copy on write, still from the resource
+        EXPECT_EQ(cb.to_string(), "#123insert9abcdefghij");
+        EXPECT_EQ(snap->to_string(), "0123insert9abcdefghij");
+    }
+    EXPECT_EQ(resource.live, 0);
+}
+
+class MappedChunkedGapBufferTest : public Test {
+protected:
+    std::string path;
+
+    void SetUp() override {
+        path = ::testing::TempDir() + "chunked_mapped_test.txt";
+    }
+
+    void TearDown() override {
+        std::remove(path.c_str());
+    }
+
+    void writeFile(const std::string& contents) {
+        std::ofstream out(path, std::ios::binary);
+        out << contents;
+    }
+};
+
+TEST_F(MappedChunkedGapBufferTest, OpenServesReadsFromMapping) {
+    writeFile("0123456789abcdefghijklmnopqrstuvwxyz");
+    const SmallChunks cb = SmallChunks::open_mapped(path);
+
+    EXPECT_EQ(cb.size(), 36);
+    EXPECT_EQ(cb.chunk_count(), 5);
+    EXPECT_EQ(cb.at(20), 'k');
+    EXPECT_EQ(std::string(cb.begin(), cb.end()),
+              "0123456789abcdefghijklmnopqrstuvwxyz");
+    EXPECT_EQ(cb.mapped_chunk_count(), 5);
+}
+
+TEST_F(MappedChunkedGapBufferTest, EditMaterializesOnlyTouchedChunk) {
+    writeFile("0123456789abcdefghijklmnopqrstuvwxyz");
+    SmallChunks cb = SmallChunks::open_mapped(path);
+
+    cb.insert(cb.begin() + 18, '_');
+    EXPECT_EQ(cb.to_string(), "0123456789abcdefgh_ijklmnopqrstuvwxyz");
+    EXPECT_EQ(cb.mapped_chunk_count(), 4);
+
+    // trimming a mapped chunk narrows the view instead of copying it
+    cb.erase(cb.begin(), 3);
+    EXPECT_EQ(cb.to_string(), "3456789abcdefgh_ijklmnopqrstuvwxyz");
+    EXPECT_EQ(cb.mapped_chunk_count(), 4);
+}
+
+TEST_F(MappedChunkedGapBufferTest, EmptyFile) {
+    writeFile("");
+    SmallChunks cb = SmallChunks::open_mapped(path);
+
+    EXPECT_TRUE(cb.empty());
+    cb.push_back('x');
+    EXPECT_EQ(cb.to_string(), "x");
+}
+
+TEST_F(MappedChunkedGapBufferTest, MissingFileThrows) {
+    EXPECT_THROW(SmallChunks::open_mapped(path + ".missing"),
+                 std::system_error);
+}
+
+TEST_F(MappedChunkedGapBufferTest, SaveOverMappedFile) {
+    writeFile("0123456789abcdefghijklmnopqrstuvwxyz");
+    SmallChunks cb = SmallChunks::open_mapped(path);
+    cb.erase(cb.begin() + 10, 26);
+    cb.insert(cb.begin() + 5, std::string_view("--"));
+    cb.save(path);
+
+    std::ifstream in(path);
+    const std::string saved((std::istreambuf_iterator<char>(in)),
+                            std::istreambuf_iterator<char>());
+    EXPECT_EQ(saved, "01234--56789");
+}
@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include <deque>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#include "deque_gb.h"
+using namespace ::testing;
+
+class DequeGbTest : public Test {
+public:
+    // Gb starts out holding "hello" with the cursor after "he"
+    static Gb empty_gb() {
+        Gb gb;
+        gb.move_cursor(gb.size());
+        gb.del(gb.size());
+        return gb;
+    }
+};
+
+TEST_F(DequeGbTest, BulkCursorMoves) {
+    Gb gb;
+    EXPECT_EQ(gb.to_string(), "hello");
+    EXPECT_EQ(gb.cursor(), 2);
+
+    gb.move_cursor(5);
+    EXPECT_EQ(gb.string_with_gap(), "hello ");
+    gb.move_cursor(0);
+    EXPECT_EQ(gb.string_with_gap(), " hello");
+    gb.move_cursor(3);
+    EXPECT_EQ(gb.string_with_gap(), "hel lo");
+    EXPECT_EQ(gb.cursor(), 3);
+
+    EXPECT_THROW(gb.move_cursor(6), std::runtime_error);
+    EXPECT_EQ(gb.string_with_gap(), "hel lo");
+}
+
+TEST_F(DequeGbTest, BulkInsertAndDelete) {
+    Gb gb = empty_gb();
+    EXPECT_EQ(gb.size(), 0);
+
+    gb.insert("hello world");
+    gb.move_cursor(5);
+    gb.insert(std::string_view(","));
+    EXPECT_EQ(gb.to_string(), "hello, world");
+
+    gb.move_cursor(12);
+    gb.del(6);
+    EXPECT_EQ(gb.to_string(), "hello,");
+    gb.del();
+    EXPECT_EQ(gb.to_string(), "hello");
+
+    EXPECT_THROW(gb.del(6), std::runtime_error);
+    EXPECT_EQ(gb.to_string(), "hello");
+}
+
+TEST_F(DequeGbTest, MatchesStringUnderRandomEdits) {
+    Gb gb = empty_gb();
+    std::string expected;
+    std::mt19937 rng(15);
+
+    for (int i = 0; i < 2000; ++i) {
+        const std::size_t pos = rng() % (expected.size() + 1);
+        gb.move_cursor(pos);
+        if (rng() % 3 == 0) {
+            const std::size_t n = rng() % (pos + 1);
+            gb.del(n);
+            expected.erase(pos - n, n);
+            ASSERT_EQ(gb.cursor(), pos - n);
+        } else {
+            const std::string text(rng() % 16, static_cast<char>('a' + i % 26));
+            gb.insert(text);
+            expected.insert(pos, text);
+            ASSERT_EQ(gb.cursor(), pos + text.size());
+        }
+        ASSERT_EQ(gb.size(), expected.size());
+    }
+    EXPECT_EQ(gb.to_string(), expected);
+}
+
+TEST_F(DequeGbTest, StatsCountSplices) {
+    static_assert(sizeof(Gb) == 2 * sizeof(std::deque<char>));
+
+    BasicGb<gb::GapStats> buffer;
+    buffer.move_cursor(5);
+    buffer.move_cursor(0);
+    buffer.move_right();
+    buffer.insert("0123456789");
+
+    const gb::StatsSnapshot stats = buffer.stats();
+    EXPECT_EQ(stats.gap_moves, 3);
+    EXPECT_EQ(stats.bytes_moved, 3 + 5 + 1);
+    EXPECT_EQ(stats.move_histogram[0], 1); // 1
+    EXPECT_EQ(stats.move_histogram[1], 1); // 3
+    EXPECT_EQ(stats.move_histogram[2], 1); // 5
+    EXPECT_EQ(stats.peak_capacity, 15);
+}
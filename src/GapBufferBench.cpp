@@ -0,0 +1,731 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "deque_gb.h"
+#include "diff.h"
+#include "gapbuffer.h"
+#include "parallel.h"
+#include "pattern_set.h"
+
+// Every engine replays the same edit traces. Alongside time per op we report
+// heap allocations per op (counted by the global operator new in
+// GapBufferBenchAlloc.cpp) and the bytes each engine has to shift to apply an
+// op, modelled from its layout.
+
+std::size_t allocation_count() noexcept;
+
+namespace {
+
+struct Op {
+    std::size_t pos;
+    std::size_t erase; // elements removed at pos
+    std::string_view text; // inserted at pos after the erase
+};
+
+constexpr std::string_view typed = "the quick brown fox jumps over a lazy dog\n";
+
+const std::string& paste_text() {
+    static const std::string text = [] {
+        std::string s;
+        while (s.size() < 16 * 1024) {
+            s += typed;
+        }
+        return s;
+    }();
+    return text;
+}
+
+std::string make_document(std::size_t size) {
+    std::string doc;
+    doc.reserve(size);
+    while (doc.size() < size) {
+        doc += typed;
+    }
+    doc.resize(size);
+    return doc;
+}
+
+std::string_view one_char(std::mt19937_64& rng) {
+    return typed.substr(rng() % typed.size(), 1);
+}
+
+// Typing in the middle of the document with the occasional backspace
+std::vector<Op> typing_trace(std::size_t docSize) {
+    std::mt19937_64 rng(1);
+    std::vector<Op> ops;
+    std::size_t cursor = docSize / 2;
+    for (int i = 0; i < 10000; ++i) {
+        if (rng() % 10 == 0 && cursor > 0) {
+            --cursor;
+            ops.push_back({cursor, 1, {}});
+        } else {
+            ops.push_back({cursor, 0, one_char(rng)});
+            ++cursor;
+        }
+    }
+    return ops;
+}
+
+// Single character inserts and deletes at uniformly random positions
+std::vector<Op> random_edit_trace(std::size_t docSize) {
+    std::mt19937_64 rng(2);
+    std::vector<Op> ops;
+    std::size_t size = docSize;
+    for (int i = 0; i < 5000; ++i) {
+        const std::size_t pos = rng() % size;
+        if (rng() % 2 == 0) {
+            ops.push_back({pos, 1, {}});
+            --size;
+        } else {
+            ops.push_back({pos, 0, one_char(rng)});
+            ++size;
+        }
+    }
+    return ops;
+}
+
+// 16 KiB blocks pasted at random positions
+std::vector<Op> paste_trace(std::size_t docSize) {
+    std::mt19937_64 rng(3);
+    std::vector<Op> ops;
+    std::size_t size = docSize;
+    for (int i = 0; i < 32; ++i) {
+        ops.push_back({rng() % size, 0, paste_text()});
+        size += paste_text().size();
+    }
+    return ops;
+}
+
+// Jump the cursor somewhere far away, then type a short word
+std::vector<Op> cursor_jump_trace(std::size_t docSize) {
+    std::mt19937_64 rng(4);
+    std::vector<Op> ops;
+    for (int i = 0; i < 1000; ++i) {
+        const std::size_t cursor = rng() % docSize;
+        for (std::size_t j = 0; j < 8; ++j) {
+            ops.push_back({cursor + j, 0, one_char(rng)});
+        }
+        docSize += 8;
+    }
+    return ops;
+}
+
+std::size_t distance(std::size_t a, std::size_t b) {
+    return a > b ? a - b : b - a;
+}
+
+class GapBufferEngine {
+public:
+    void load(const std::string& doc) {
+        gb = GapBuffer<char>(std::string_view(doc));
+        gapIndex = doc.size();
+    }
+
+    void apply(const Op& op) {
+        const std::size_t size = gb.size();
+        const std::size_t capacity = gb.capacity();
+        if (op.erase > 0) {
+            // erase joins the gap from whichever side is closer
+            if (gapIndex >= op.pos + op.erase) {
+                moved += gapIndex - (op.pos + op.erase);
+            } else {
+                moved += distance(gapIndex, op.pos);
+            }
+            gb.erase(gb.begin() + op.pos, gb.begin() + op.pos + op.erase);
+            gapIndex = op.pos;
+        }
+        if (!op.text.empty()) {
+            moved += distance(gapIndex, op.pos);
+            gb.insert(gb.begin() + op.pos, op.text);
+            gapIndex = op.pos + op.text.size();
+        }
+        if (gb.capacity() != capacity) {
+            moved += size; // reallocation copies the whole content
+        }
+    }
+
+    std::size_t size() const {
+        return gb.size();
+    }
+
+    std::size_t moved = 0;
+
+private:
+    GapBuffer<char> gb;
+    std::size_t gapIndex = 0;
+};
+
+class DequeEngine {
+public:
+    void load(const std::string& doc) {
+        gb = Gb();
+        // Gb starts out with demo contents, drop them first
+        gb.move_cursor(gb.size());
+        gb.del(gb.size());
+        gb.insert(doc);
+        cursor = doc.size();
+        length = doc.size();
+    }
+
+    void apply(const Op& op) {
+        // Gb::del is a backspace, so park the cursor after the erased range
+        if (op.erase > 0) {
+            moved += distance(cursor, op.pos + op.erase);
+            gb.move_cursor(op.pos + op.erase);
+            gb.del(op.erase);
+            cursor = op.pos;
+            length -= op.erase;
+        }
+        if (!op.text.empty()) {
+            moved += distance(cursor, op.pos);
+            gb.move_cursor(op.pos);
+            gb.insert(op.text);
+            cursor = op.pos + op.text.size();
+            length += op.text.size();
+        }
+    }
+
+    std::size_t size() const {
+        return length;
+    }
+
+    std::size_t moved = 0;
+
+private:
+    Gb gb;
+    std::size_t cursor = 0;
+    std::size_t length = 0;
+};
+
+class StringEngine {
+public:
+    void load(const std::string& doc) {
+        str = doc;
+    }
+
+    void apply(const Op& op) {
+        const std::size_t size = str.size();
+        const std::size_t capacity = str.capacity();
+        if (op.erase > 0) {
+            moved += str.size() - op.pos - op.erase;
+            str.erase(op.pos, op.erase);
+        }
+        if (!op.text.empty()) {
+            moved += str.size() - op.pos;
+            str.insert(op.pos, op.text);
+        }
+        if (str.capacity() != capacity) {
+            moved += size;
+        }
+    }
+
+    std::size_t size() const {
+        return str.size();
+    }
+
+    std::size_t moved = 0;
+
+private:
+    std::string str;
+};
+
+template <typename Engine>
+void replay(benchmark::State& state,
+            std::vector<Op> (*makeTrace)(std::size_t)) {
+    const std::size_t docSize = state.range(0);
+    const std::string doc = make_document(docSize);
+    const std::vector<Op> trace = makeTrace(docSize);
+
+    std::size_t moved = 0;
+    std::size_t allocations = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        Engine engine;
+        engine.load(doc);
+        const std::size_t allocationsBefore = allocation_count();
+        state.ResumeTiming();
+
+        for (const Op& op : trace) {
+            engine.apply(op);
+        }
+        benchmark::DoNotOptimize(engine.size());
+
+        state.PauseTiming();
+        allocations += allocation_count() - allocationsBefore;
+        moved += engine.moved;
+        state.ResumeTiming();
+    }
+
+    const double ops = static_cast<double>(trace.size()) * state.iterations();
+    state.SetItemsProcessed(static_cast<int64_t>(ops));
+    state.counters["time/op"] = benchmark::Counter(
+        ops, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    state.counters["bytes_moved/op"] = moved / ops;
+    state.counters["allocs/op"] = allocations / ops;
+}
+
+struct Trace {
+    const char* name;
+    std::vector<Op> (*make)(std::size_t);
+};
+
+constexpr Trace traces[] = {
+    {"Typing", typing_trace},
+    {"RandomEdits", random_edit_trace},
+    {"LargePaste", paste_trace},
+    {"CursorJumps", cursor_jump_trace},
+};
+
+template <typename Engine>
+void register_engine(const std::string& engine) {
+    for (const Trace& trace : traces) {
+        const std::string name = engine + "/" + trace.name;
+        benchmark::RegisterBenchmark(name.c_str(), replay<Engine>, trace.make)
+            ->Arg(64 * 1024)
+            ->Arg(1024 * 1024)
+            ->Unit(benchmark::kMillisecond);
+    }
+}
+
+// Searching for a needle that only occurs at the very end, with the gap in
+// the middle of the document
+GapBuffer<char> search_document(std::size_t size) {
+    GapBuffer<char> gb(std::string_view(make_document(size)));
+    gb.insert(gb.begin() + size / 2, 'x');
+    gb.insert(gb.end(), std::string_view("needle"));
+    return gb;
+}
+
+void search_member_find(benchmark::State& state) {
+    const GapBuffer<char> gb = search_document(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(gb.find(std::string_view("needle")));
+    }
+    state.SetBytesProcessed(state.iterations() * gb.size());
+}
+
+void search_std_search(benchmark::State& state) {
+    const GapBuffer<char> gb = search_document(state.range(0));
+    constexpr std::string_view needle = "needle";
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+            std::search(gb.begin(), gb.end(), needle.begin(), needle.end()));
+    }
+    state.SetBytesProcessed(state.iterations() * gb.size());
+}
+
+// Bounce the gap between the two ends of the document: every iteration
+// relocates the whole content once
+void gap_move(benchmark::State& state) {
+    GapBuffer<char> gb(std::string_view(make_document(state.range(0))));
+    bool atEnd = true;
+    for (auto _ : state) {
+        if (atEnd) {
+            gb.insert(gb.begin(), 'x');
+            gb.erase(gb.begin());
+        } else {
+            gb.push_back('x');
+            gb.erase(gb.end() - 1);
+        }
+        atEnd = !atEnd;
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * gb.size());
+}
+
+// std::count over a GapBuffer (one gap check per element), gb::count over
+// the same buffer (two plain loops) and std::count over a std::string
+template <typename Count>
+void count_with(benchmark::State& state, Count&& count) {
+    GapBuffer<char> gb(std::string_view(make_document(state.range(0))));
+    gb.insert(gb.begin() + gb.size() / 2, '\n'); // gap in the middle
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(count(gb.cbegin(), gb.cend()));
+    }
+    state.SetBytesProcessed(state.iterations() * gb.size());
+}
+
+void count_std(benchmark::State& state) {
+    count_with(state, [](auto first, auto last) {
+        return std::count(first, last, 'e');
+    });
+}
+
+void count_segmented(benchmark::State& state) {
+    count_with(state, [](auto first, auto last) {
+        return gb::count(first, last, 'e');
+    });
+}
+
+void count_string(benchmark::State& state) {
+    const std::string doc = make_document(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(std::count(doc.begin(), doc.end(), 'e'));
+    }
+    state.SetBytesProcessed(state.iterations() * doc.size());
+}
+
+// A formatter pass: 10k small replacements spread over the whole document
+std::vector<GapBuffer<char>::Edit> formatter_edits(std::size_t docSize) {
+    static constexpr std::string_view indent = "    ";
+    std::vector<GapBuffer<char>::Edit> edits;
+    const std::size_t step = docSize / 10000;
+    for (std::size_t pos = 0; pos + 2 <= docSize && edits.size() < 10000;
+         pos += step) {
+        edits.push_back({pos, 2, indent});
+    }
+    return edits;
+}
+
+void batch_sequential(benchmark::State& state) {
+    const std::string doc = make_document(state.range(0));
+    const auto edits = formatter_edits(doc.size());
+    for (auto _ : state) {
+        state.PauseTiming();
+        GapBuffer<char> gb{std::string_view(doc)};
+        state.ResumeTiming();
+        std::size_t shift = 0;
+        for (const auto& edit : edits) {
+            const auto at = gb.begin() + (edit.offset + shift);
+            gb.erase(at, edit.erase);
+            gb.insert(gb.begin() + (edit.offset + shift),
+                      edit.insert.begin(), edit.insert.end());
+            shift += edit.insert.size() - edit.erase;
+        }
+        benchmark::DoNotOptimize(gb.size());
+    }
+    state.SetItemsProcessed(state.iterations() * edits.size());
+}
+
+void batch_apply(benchmark::State& state) {
+    const std::string doc = make_document(state.range(0));
+    const auto edits = formatter_edits(doc.size());
+    for (auto _ : state) {
+        state.PauseTiming();
+        GapBuffer<char> gb{std::string_view(doc)};
+        state.ResumeTiming();
+        gb.apply_batch(edits);
+        benchmark::DoNotOptimize(gb.size());
+    }
+    state.SetItemsProcessed(state.iterations() * edits.size());
+}
+
+// Replace every "fox" in the document (one per line): erase and insert at
+// each match, against a single replace_all
+void replace_sequential(benchmark::State& state) {
+    const std::string doc = make_document(state.range(0));
+    std::size_t replaced = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        GapBuffer<char> gb{std::string_view(doc)};
+        state.ResumeTiming();
+        replaced = 0;
+        for (std::size_t pos = gb.find(std::string_view("fox"));
+             pos != GapBuffer<char>::npos;
+             pos = gb.find(std::string_view("fox"), pos + 6)) {
+            gb.erase(gb.begin() + pos, 3);
+            gb.insert(gb.begin() + pos, std::string_view("jackal"));
+            ++replaced;
+        }
+        benchmark::DoNotOptimize(gb.size());
+    }
+    state.SetItemsProcessed(state.iterations() * replaced);
+}
+
+void replace_all(benchmark::State& state) {
+    const std::string doc = make_document(state.range(0));
+    std::size_t replaced = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        GapBuffer<char> gb{std::string_view(doc)};
+        state.ResumeTiming();
+        replaced = gb.replace_all("fox", "jackal");
+        benchmark::DoNotOptimize(gb.size());
+    }
+    state.SetItemsProcessed(state.iterations() * replaced);
+}
+
+// A highlighter's keyword list, searched one find_all pass per keyword or
+// in a single PatternSet pass
+const std::vector<std::string_view> keywords = {
+    "quick", "brown", "fox",  "jumps", "over", "lazy", "dog",   "the",
+    "cat",   "bird",  "fish", "red",   "blue", "slow", "under", "while",
+};
+
+void multi_search_find_all(benchmark::State& state) {
+    GapBuffer<char> gb(std::string_view(make_document(state.range(0))));
+    gb.insert(gb.begin() + gb.size() / 2, '\n');
+    for (auto _ : state) {
+        std::size_t matches = 0;
+        for (const std::string_view keyword : keywords) {
+            matches += gb.find_all(keyword).size();
+        }
+        benchmark::DoNotOptimize(matches);
+    }
+    state.SetBytesProcessed(state.iterations() * gb.size());
+}
+
+void multi_search_pattern_set(benchmark::State& state) {
+    GapBuffer<char> gb(std::string_view(make_document(state.range(0))));
+    gb.insert(gb.begin() + gb.size() / 2, '\n');
+    std::vector<gb::Pattern> patterns;
+    for (const std::string_view keyword : keywords) {
+        patterns.push_back(gb::Pattern::literal(keyword));
+    }
+    const gb::PatternSet set(patterns);
+    for (auto _ : state) {
+        std::size_t matches = 0;
+        set.for_each_match(gb, [&](const gb::PatternSet::Match&) {
+            ++matches;
+        });
+        benchmark::DoNotOptimize(matches);
+    }
+    state.SetBytesProcessed(state.iterations() * gb.size());
+}
+
+void multi_search_regex(benchmark::State& state) {
+    GapBuffer<char> gb(std::string_view(make_document(state.range(0))));
+    gb.insert(gb.begin() + gb.size() / 2, '\n');
+    const gb::PatternSet set({gb::Pattern::regex(R"(\bq\w+)"),
+                              gb::Pattern::regex("o[uv]er|under"),
+                              gb::Pattern::regex("^the")});
+    for (auto _ : state) {
+        std::size_t matches = 0;
+        set.for_each_match(gb, [&](const gb::PatternSet::Match&) {
+            ++matches;
+        });
+        benchmark::DoNotOptimize(matches);
+    }
+    state.SetBytesProcessed(state.iterations() * gb.size());
+}
+
+// Reopen 100 documents with their line index: each restored from a session
+// against each read back as text and indexed again
+constexpr std::size_t startupDocuments = 100;
+
+std::vector<std::string> startup_files(const std::size_t docSize,
+                                       const bool session) {
+    const std::string doc = make_document(docSize);
+    const auto dir = std::filesystem::temp_directory_path();
+    std::vector<std::string> paths;
+    for (std::size_t i = 0; i < startupDocuments; ++i) {
+        GapBuffer<char> gb{std::string_view(doc)};
+        gb.enable_line_index();
+        gb.insert(gb.begin() + (i * 997) % doc.size(), '\n');
+        paths.push_back((dir / ("gb_startup_" + std::to_string(i) +
+                                (session ? ".session" : ".txt")))
+                            .string());
+        if (session) {
+            gb.save_session(paths.back());
+        } else {
+            gb.save(paths.back());
+        }
+    }
+    return paths;
+}
+
+void startup_reindex(benchmark::State& state) {
+    const auto paths = startup_files(state.range(0), false);
+    for (auto _ : state) {
+        std::size_t lines = 0;
+        for (const std::string& path : paths) {
+            std::ifstream in(path, std::ios::binary);
+            const std::string text(std::istreambuf_iterator<char>(in), {});
+            GapBuffer<char> gb{std::string_view(text)};
+            gb.enable_line_index();
+            lines += gb.line_count();
+        }
+        benchmark::DoNotOptimize(lines);
+    }
+    for (const std::string& path : paths) {
+        std::filesystem::remove(path);
+    }
+}
+
+void startup_session(benchmark::State& state) {
+    const auto paths = startup_files(state.range(0), true);
+    for (auto _ : state) {
+        std::size_t lines = 0;
+        for (const std::string& path : paths) {
+            lines += GapBuffer<char>::load_session(path).line_count();
+        }
+        benchmark::DoNotOptimize(lines);
+    }
+    for (const std::string& path : paths) {
+        std::filesystem::remove(path);
+    }
+}
+
+// A formatter pass over the document (formatter_edits) as the two versions
+// to compare: copied out to strings, as callers do today, or diffed
+std::pair<GapBuffer<char>, GapBuffer<char>> diff_versions(
+    const std::size_t docSize) {
+    const std::string doc = make_document(docSize);
+    GapBuffer<char> before{std::string_view(doc)};
+    GapBuffer<char> after = before;
+    after.apply_batch(formatter_edits(doc.size()), after.size() / 3);
+    before.insert(before.begin() + before.size() / 2, '\n');
+    before.erase(before.begin() + before.size() / 2, 1);
+    return {std::move(before), std::move(after)};
+}
+
+void diff_to_string(benchmark::State& state) {
+    const auto [before, after] = diff_versions(state.range(0));
+    for (auto _ : state) {
+        const std::string a = before.to_string();
+        const std::string b = after.to_string();
+        benchmark::DoNotOptimize(a == b);
+    }
+    state.SetBytesProcessed(state.iterations() * before.size());
+}
+
+void diff_buffers(benchmark::State& state) {
+    const auto [before, after] = diff_versions(state.range(0));
+    std::size_t edits = 0;
+    for (auto _ : state) {
+        edits = gb::diff(before, after).size();
+        benchmark::DoNotOptimize(edits);
+    }
+    state.counters["edits"] = static_cast<double>(edits);
+    state.SetBytesProcessed(state.iterations() * before.size());
+}
+
+// One typed word in the middle: all prefix and suffix trimming
+void diff_local(benchmark::State& state) {
+    GapBuffer<char> before(std::string_view(make_document(state.range(0))));
+    GapBuffer<char> after = before;
+    after.insert(after.begin() + after.size() / 2, std::string_view("word"));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(gb::diff(before, after).size());
+    }
+    state.SetBytesProcessed(state.iterations() * before.size());
+}
+
+// Whole-buffer passes over 64 MiB with the gap in the middle: one thread
+// against gb::parallel on ThreadPool::shared()
+GapBuffer<char> large_buffer(const std::size_t size) {
+    GapBuffer<char> gb(std::string_view(make_document(size)));
+    gb.insert(gb.begin() + size / 2, '\n');
+    return gb;
+}
+
+void lines_sequential(benchmark::State& state) {
+    const GapBuffer<char> gb = large_buffer(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(gb.count('\n'));
+    }
+    state.SetBytesProcessed(state.iterations() * gb.size());
+}
+
+void lines_parallel(benchmark::State& state) {
+    const GapBuffer<char> gb = large_buffer(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(gb::parallel::count(gb, '\n'));
+    }
+    state.counters["threads"] = gb::ThreadPool::shared().size() + 1;
+    state.SetBytesProcessed(state.iterations() * gb.size());
+}
+
+void utf8_sequential(benchmark::State& state) {
+    const GapBuffer<char> gb = large_buffer(state.range(0));
+    for (auto _ : state) {
+        for (const std::span<const char> segment : gb.segments()) {
+            const char* end = segment.data() + segment.size();
+            benchmark::DoNotOptimize(
+                gb::utf8::validate(segment.data(), end) == end);
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * gb.size());
+}
+
+void utf8_parallel(benchmark::State& state) {
+    const GapBuffer<char> gb = large_buffer(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(gb::parallel::validate_utf8(gb));
+    }
+    state.counters["threads"] = gb::ThreadPool::shared().size() + 1;
+    state.SetBytesProcessed(state.iterations() * gb.size());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    register_engine<GapBufferEngine>("GapBuffer");
+    register_engine<DequeEngine>("Gb");
+    register_engine<StringEngine>("std::string");
+    benchmark::RegisterBenchmark("Search/GapBuffer::find", search_member_find)
+        ->Arg(1024 * 1024);
+    benchmark::RegisterBenchmark("Search/std::search", search_std_search)
+        ->Arg(1024 * 1024);
+    benchmark::RegisterBenchmark("GapMove", gap_move)->Arg(4 * 1024 * 1024);
+    benchmark::RegisterBenchmark("Count/std::count", count_std)
+        ->Arg(4 * 1024 * 1024);
+    benchmark::RegisterBenchmark("Count/gb::count", count_segmented)
+        ->Arg(4 * 1024 * 1024);
+    benchmark::RegisterBenchmark("Count/std::string", count_string)
+        ->Arg(4 * 1024 * 1024);
+    benchmark::RegisterBenchmark("Batch/sequential", batch_sequential)
+        ->Arg(1024 * 1024)
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark("Batch/apply_batch", batch_apply)
+        ->Arg(1024 * 1024)
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark("ReplaceAll/sequential", replace_sequential)
+        ->Arg(1024 * 1024)
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark("ReplaceAll/replace_all", replace_all)
+        ->Arg(1024 * 1024)
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark("MultiSearch/find_all x16",
+                                 multi_search_find_all)
+        ->Arg(1024 * 1024);
+    benchmark::RegisterBenchmark("MultiSearch/PatternSet x16",
+                                 multi_search_pattern_set)
+        ->Arg(1024 * 1024);
+    benchmark::RegisterBenchmark("MultiSearch/PatternSet regex x3",
+                                 multi_search_regex)
+        ->Arg(1024 * 1024);
+    benchmark::RegisterBenchmark("Diff/to_string", diff_to_string)
+        ->Arg(1024 * 1024);
+    benchmark::RegisterBenchmark("Diff/diff formatter", diff_buffers)
+        ->Arg(1024 * 1024);
+    benchmark::RegisterBenchmark("Diff/diff one word", diff_local)
+        ->Arg(1024 * 1024);
+    benchmark::RegisterBenchmark("Parallel/count lines sequential",
+                                 lines_sequential)
+        ->Arg(64 << 20)
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark("Parallel/count lines", lines_parallel)
+        ->Arg(64 << 20)
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark("Parallel/validate_utf8 sequential",
+                                 utf8_sequential)
+        ->Arg(64 << 20)
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark("Parallel/validate_utf8", utf8_parallel)
+        ->Arg(64 << 20)
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark("Startup/reindex x100", startup_reindex)
+        ->Arg(256 * 1024)
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark("Startup/load_session x100", startup_session)
+        ->Arg(256 * 1024)
+        ->Unit(benchmark::kMillisecond);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
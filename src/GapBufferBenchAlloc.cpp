@@ -0,0 +1,34 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// The global operator new and delete for gbbench, counting allocations.
+// They live in their own file so that GCC never inlines them into the
+// benchmarks, where it would pair malloc in one with free in the other and
+// warn about mismatched new and delete.
+
+namespace {
+// relaxed: the parallel benchmarks allocate from worker threads
+std::atomic<std::size_t> allocationCount{0};
+} // namespace
+
+std::size_t allocation_count() noexcept {
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
@@ -1,9 +1,25 @@
 #include "gtest/gtest.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <gtest/gtest.h>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <random>
+#include <regex>
+#include <sstream>
 #include <string>
 #include <variant>
 
+#include "diff.h"
 #include "gapbuffer.h"
+#include "parallel.h"
+#include "pattern_set.h"
+#include "pool_allocator.h"
 using namespace ::testing;
 
 class GapBufferTest : public Test {
@@ -40,9 +56,1620 @@ TEST_F(GapBufferTest, StringViewConstructor) {
 
     EXPECT_EQ(gb.size(), 11);
     std::cout << "FLAG\n";
-    // Uncomment these once basic errors are fixed
-    //EXPECT_EQ(gb.capacity(), gb.size() + gb.gapSize());
-    //EXPECT_EQ(gb.to_string(), "hello world");
+    EXPECT_EQ(gb.capacity(), gb.size() + gb.gapSize());
+    EXPECT_EQ(gb.to_string(), "hello world");
+}
+
+TEST_F(GapBufferTest, InsertRange) {
+    std::vector<char> v = {'w', 'o', 'r', 'l', 'd'};
+    auto gb = GapBuffer<char>(std::string_view("hello "));
+    gb.insert(gb.end(), v.begin(), v.end());
+
+    EXPECT_EQ(gb.size(), 11);
+    EXPECT_EQ(gb.to_string(), "hello world");
+}
+
+TEST_F(GapBufferTest, InsertStringViewMiddle) {
+    auto gb = GapBuffer<char>(std::string_view("hed"));
+    gb.insert(gb.begin() + 2, std::string_view("llo worl"));
+
+    EXPECT_EQ(gb.to_string(), "hello world");
+    EXPECT_EQ(gb.at(4), 'o');
+    EXPECT_EQ(gb.at(10), 'd');
+}
+
+TEST_F(GapBufferTest, InsertStringViewGrowsOnce) {
+    auto gb = GapBuffer<char>();
+    const std::string paste(1000, 'x');
+    gb.insert(gb.begin(), std::string_view(paste));
+
+    // one reallocation straight to the required capacity, no doubling rounds
+    EXPECT_EQ(gb.capacity(), 1000);
+    EXPECT_EQ(gb.size(), 1000);
+    EXPECT_EQ(gb.to_string(), paste);
+}
+
+TEST_F(GapBufferTest, EraseRange) {
+    auto gb = GapBuffer<char>(std::string_view("hello cruel world"));
+    gb.erase(gb.begin() + 5, gb.begin() + 11);
+
+    EXPECT_EQ(gb.size(), 11);
+    EXPECT_EQ(gb.to_string(), "hello world");
+    EXPECT_EQ(gb.capacity(), gb.size() + gb.gapSize());
+}
+
+TEST_F(GapBufferTest, EraseRangeAfterGap) {
+    auto gb = GapBuffer<char>(std::string_view("hello world"));
+    gb.insert(gb.begin(), '>');
+    gb.erase(gb.begin() + 6, gb.end());
+
+    EXPECT_EQ(gb.to_string(), ">hello");
+    EXPECT_EQ(*gb.rbegin(), 'o');
+}
+
+TEST_F(GapBufferTest, FixedGapGrowth) {
+    auto gb = GapBuffer<char, std::allocator<char>, FixedGapGrowth<4>>();
+    EXPECT_EQ(gb.capacity(), 4);
+
+    gb.insert(gb.end(), std::string_view("hello"));
+    EXPECT_EQ(gb.capacity(), 5 + 4);
+    gb.insert(gb.end(), std::string_view(" world"));
+    EXPECT_EQ(gb.capacity(), 11 + 4);
+    EXPECT_EQ(gb.to_string(), "hello world");
+}
+
+TEST_F(GapBufferTest, ProportionalGrowth) {
+    using Proportional = ProportionalGrowth<50, 2, 100>;
+    const std::string s(40, 'x');
+    auto gb = GapBuffer<char, std::allocator<char>, Proportional>(s);
+    EXPECT_EQ(gb.gapSize(), 20);
+
+    const std::string big(1000, 'y');
+    gb.insert(gb.begin(), std::string_view(big));
+    EXPECT_EQ(gb.gapSize(), 100); // clamped to MaxGap
+    EXPECT_EQ(gb.size(), 1040);
+}
+
+TEST_F(GapBufferTest, ShrinkOnEraseHysteresis) {
+    auto gb = GapBuffer<char, std::allocator<char>, FixedGapGrowth<4>>(
+        std::string_view("0123456789abcdefghij"));
+    EXPECT_EQ(gb.capacity(), 24);
+
+    // a gap of 16 is still within four times the fixed gap
+    gb.erase(gb.begin(), gb.begin() + 12);
+    EXPECT_EQ(gb.capacity(), 24);
+
+    gb.erase(gb.begin(), gb.begin() + 2);
+    EXPECT_EQ(gb.capacity(), 6 + 4);
+    EXPECT_EQ(gb.to_string(), "efghij");
+}
+
+TEST_F(GapBufferTest, GeometricMaxGap) {
+    auto gb = GapBuffer<char, std::allocator<char>, GeometricGrowth<2, 1, 16>>(
+        std::string_view("0123456789"));
+    const std::string more(30, 'z');
+    gb.insert(gb.end(), std::string_view(more));
+    gb.push_back('!');
+
+    EXPECT_LE(gb.gapSize(), 16);
+    EXPECT_EQ(gb.size(), 41);
+}
+
+TEST_F(GapBufferTest, IteratorSkipsGap) {
+    auto gb = GapBuffer<char>(std::string_view("hello world"));
+    gb.insert(gb.begin() + 5, ',');
+
+    std::string visited(gb.begin(), gb.end());
+    EXPECT_EQ(visited, "hello, world");
+    EXPECT_EQ(gb.end() - gb.begin(), 12);
+    EXPECT_EQ(*(gb.begin() + 6), ' ');
+    EXPECT_EQ(*(gb.end() - 6), ' ');
+}
+
+TEST_F(GapBufferTest, Segments) {
+    auto gb = GapBuffer<char>(std::string_view("hello world"));
+    gb.insert(gb.begin() + 5, ',');
+
+    const auto [prefix, suffix] = std::as_const(gb).segments();
+    EXPECT_EQ(std::string(prefix.begin(), prefix.end()), "hello,");
+    EXPECT_EQ(std::string(suffix.begin(), suffix.end()), " world");
+}
+
+TEST_F(GapBufferTest, SaveWritesBothSegments) {
+    const std::string path = ::testing::TempDir() + "gapbuffer_save_test.txt";
+    {
+        std::ofstream out(path);
+        out << "stale contents that are longer than the new ones";
+    }
+
+    auto gb = GapBuffer<char>(std::string_view("hello world"));
+    gb.insert(gb.begin() + 5, ',');
+    gb.save(path);
+
+    std::ifstream in(path);
+    std::stringstream contents;
+    contents << in.rdbuf();
+    EXPECT_EQ(contents.str(), "hello, world");
+    std::remove(path.c_str());
+}
+
+// "hello, |gap| world, hello"
+static GapBuffer<char> searchBuffer() {
+    auto gb = GapBuffer<char>(std::string_view("hello world, hello"));
+    gb.insert(gb.begin() + 5, ',');
+    return gb;
+}
+
+TEST_F(GapBufferTest, FindChar) {
+    const auto gb = searchBuffer();
+
+    EXPECT_EQ(gb.find('h'), 0);
+    EXPECT_EQ(gb.find(','), 5);
+    EXPECT_EQ(gb.find('w'), 7);
+    EXPECT_EQ(gb.find('h', 1), 14);
+    EXPECT_EQ(gb.find('z'), GapBuffer<char>::npos);
+}
+
+TEST_F(GapBufferTest, FindStringAcrossGap) {
+    const auto gb = searchBuffer();
+
+    EXPECT_EQ(gb.find(std::string_view("hello")), 0);
+    EXPECT_EQ(gb.find(std::string_view("lo, wo")), 3); // straddles the gap
+    EXPECT_EQ(gb.find(std::string_view("hello"), 1), 14);
+    EXPECT_EQ(gb.find(std::string_view("world!")), GapBuffer<char>::npos);
+}
+
+TEST_F(GapBufferTest, RFind) {
+    const auto gb = searchBuffer();
+
+    EXPECT_EQ(gb.rfind('h'), 14);
+    EXPECT_EQ(gb.rfind('h', 13), 0);
+    EXPECT_EQ(gb.rfind(std::string_view("hello")), 14);
+    EXPECT_EQ(gb.rfind(std::string_view("hello"), 13), 0);
+    EXPECT_EQ(gb.rfind(std::string_view("o, w")), 4);
+    EXPECT_EQ(gb.rfind(std::string_view("xyz")), GapBuffer<char>::npos);
+}
+
+TEST_F(GapBufferTest, FindAll) {
+    const auto gb = searchBuffer();
+
+    EXPECT_EQ(gb.find_all(std::string_view("l")),
+              (std::vector<size_t>{2, 3, 10, 16, 17}));
+    EXPECT_EQ(gb.find_all(std::string_view("hello")),
+              (std::vector<size_t>{0, 14}));
+}
+
+TEST_F(GapBufferTest, FindMatchesStdString) {
+    std::mt19937 rng(11);
+    std::string text;
+    for (int i = 0; i < 3000; ++i) {
+        text += "ab\n"[rng() % 3];
+    }
+
+    for (size_t gapAt : {size_t{0}, size_t{1}, size_t{1500}, text.size()}) {
+        auto gb = GapBuffer<char>(std::string_view(text));
+        gb.insert(gb.begin() + gapAt, 'X');
+        gb.erase(gb.begin() + gapAt); // leaves the gap at gapAt
+
+        for (const std::string needle : {"a", "ab\nab", "bbbbbb", "\n\n\n",
+                                         "abab\nbaba\nb"}) {
+            for (size_t pos : {size_t{0}, size_t{700}, size_t{1499}}) {
+                ASSERT_EQ(gb.find(std::string_view(needle), pos),
+                          text.find(needle, pos));
+                ASSERT_EQ(gb.rfind(std::string_view(needle), pos),
+                          text.rfind(needle, pos));
+            }
+            ASSERT_EQ(gb.rfind(std::string_view(needle)), text.rfind(needle));
+        }
+    }
+}
+
+TEST_F(GapBufferTest, LineQueriesWithoutIndex) {
+    auto gb = GapBuffer<char>(std::string_view("one\ntwo\n\nfour"));
+    gb.insert(gb.begin() + 6, 'X'); // gap inside line 1
+
+    EXPECT_FALSE(gb.has_line_index());
+    EXPECT_EQ(gb.line_count(), 4);
+    EXPECT_EQ(gb.line_to_offset(0), 0);
+    EXPECT_EQ(gb.line_to_offset(1), 4);
+    EXPECT_EQ(gb.line_to_offset(2), 9);
+    EXPECT_EQ(gb.line_to_offset(3), 10);
+    EXPECT_THROW(gb.line_to_offset(4), std::out_of_range);
+    EXPECT_EQ(gb.offset_to_line_col(7), (LineCol{1, 3}));
+    EXPECT_EQ(gb.offset_to_line_col(gb.size()), (LineCol{3, 4}));
+    EXPECT_THROW(gb.offset_to_line_col(gb.size() + 1), std::out_of_range);
+}
+
+TEST_F(GapBufferTest, LineIndexMatchesStringUnderRandomEdits) {
+    std::mt19937 rng(5);
+    std::string expected;
+    for (int i = 0; i < 20000; ++i) {
+        expected += "abc\n"[rng() % 4];
+    }
+    auto gb = GapBuffer<char>(std::string_view(expected));
+    gb.enable_line_index();
+
+    const auto lineStarts = [&] {
+        std::vector<size_t> starts{0};
+        for (size_t i = 0; i < expected.size(); ++i) {
+            if (expected[i] == '\n') {
+                starts.push_back(i + 1);
+            }
+        }
+        return starts;
+    };
+
+    for (int i = 0; i < 400; ++i) {
+        const size_t pos = expected.empty() ? 0 : rng() % expected.size();
+        if (rng() % 3 == 0) {
+            const size_t n =
+                std::min<size_t>(rng() % 9000, expected.size() - pos);
+            gb.erase(gb.begin() + pos, n);
+            expected.erase(pos, n);
+        } else {
+            std::string text(rng() % 5000, 'x');
+            for (char& c : text) {
+                c = "xy\n"[rng() % 3];
+            }
+            gb.insert(gb.begin() + pos, std::string_view(text));
+            expected.insert(pos, text);
+        }
+
+        const std::vector<size_t> starts = lineStarts();
+        ASSERT_EQ(gb.line_count(), starts.size());
+        for (int probe = 0; probe < 4; ++probe) {
+            const size_t line = rng() % starts.size();
+            ASSERT_EQ(gb.line_to_offset(line), starts[line]);
+            const size_t offset = rng() % (expected.size() + 1);
+            const size_t l = std::upper_bound(starts.begin(), starts.end(),
+                                              offset) -
+                             starts.begin() - 1;
+            ASSERT_EQ(gb.offset_to_line_col(offset),
+                      (LineCol{l, offset - starts[l]}));
+        }
+    }
+
+    gb.clear();
+    EXPECT_EQ(gb.line_count(), 1);
+    gb.push_back('\n');
+    EXPECT_EQ(gb.line_to_offset(1), 1);
+}
+
+TEST_F(GapBufferTest, ApplyBatch) {
+    using Edit = GapBuffer<char>::Edit;
+    auto gb = GapBuffer<char>(std::string_view("int a=1;int b=2;"));
+    gb.insert(gb.begin() + 8, 'X');
+    gb.erase(gb.begin() + 8); // gap in the middle
+
+    const std::string_view space = " ";
+    const std::string_view spacedEq = " = ";
+    const std::string_view newline = "\n";
+    const Edit edits[] = {{5, 1, spacedEq},
+                          {8, 0, newline},
+                          {13, 1, spacedEq},
+                          {16, 0, newline}};
+    gb.apply_batch(edits, 0);
+
+    EXPECT_EQ(gb.to_string(), "int a = 1;\nint b = 2;\n");
+    EXPECT_TRUE(gb.segments()[0].empty()); // gap at the caller's position
+
+    const Edit tail[] = {{0, 0, space}, {11, 4, {}}};
+    gb.apply_batch(tail);
+    EXPECT_EQ(gb.to_string(), " int a = 1;\nb = 2;\n");
+    EXPECT_EQ(gb.segments()[0].size(), 12u); // after the last edit
+}
+
+TEST_F(GapBufferTest, ApplyBatchRejectsMalformedBatch) {
+    using Edit = GapBuffer<char>::Edit;
+    auto gb = GapBuffer<char>(std::string_view("abcdef"));
+    const std::string_view x = "x";
+
+    const Edit unsorted[] = {{4, 0, x}, {2, 0, x}};
+    const Edit overlapping[] = {{1, 3, x}, {2, 0, x}};
+    const Edit outOfBounds[] = {{5, 2, x}};
+    EXPECT_THROW(gb.apply_batch(unsorted), std::invalid_argument);
+    EXPECT_THROW(gb.apply_batch(overlapping), std::invalid_argument);
+    EXPECT_THROW(gb.apply_batch(outOfBounds), std::invalid_argument);
+    EXPECT_EQ(gb.to_string(), "abcdef");
+}
+
+TEST_F(GapBufferTest, ApplyBatchMatchesSequentialEdits) {
+    using Edit = GapBuffer<char>::Edit;
+    std::mt19937 rng(9);
+    const std::string text = "abcdefghijklm\nnopqrstuvwxyz\n0123456789";
+
+    for (int round = 0; round < 50; ++round) {
+        std::string expected(rng() % 300, 'a');
+        for (char& c : expected) {
+            c = text[rng() % text.size()];
+        }
+        auto gb = GapBuffer<char>(std::string_view(expected));
+        gb.enable_line_index();
+
+        std::vector<Edit> edits;
+        for (size_t pos = 0; pos < expected.size();) {
+            pos += rng() % 20;
+            if (pos > expected.size()) {
+                break;
+            }
+            const size_t erase =
+                std::min<size_t>(rng() % 4, expected.size() - pos);
+            const size_t at = rng() % text.size();
+            const size_t length = std::min<size_t>(rng() % 8, text.size() - at);
+            edits.push_back({pos, erase, std::span(text).subspan(at, length)});
+            pos += erase;
+        }
+        for (auto it = edits.rbegin(); it != edits.rend(); ++it) {
+            expected.replace(it->offset, it->erase, it->insert.data(),
+                             it->insert.size());
+        }
+
+        const size_t gapAt = rng() % (expected.size() + 1);
+        gb.apply_batch(edits, gapAt);
+        ASSERT_EQ(gb.to_string(), expected);
+        if (!edits.empty()) { // an empty batch leaves the gap alone
+            ASSERT_EQ(gb.segments()[0].size(), gapAt);
+        }
+        ASSERT_EQ(gb.line_count(),
+                  1 + std::count(expected.begin(), expected.end(), '\n'));
+    }
+}
+
+TEST_F(GapBufferTest, ReplaceAll) {
+    auto buffer = GapBuffer<char>(std::string_view("a-b-c--d"));
+    buffer.insert(buffer.begin() + 4, '-');
+    buffer.erase(buffer.begin() + 4); // gap in the middle
+    buffer.enable_line_index();
+
+    EXPECT_EQ(buffer.replace_all("--", "\n"), 1);
+    EXPECT_EQ(buffer.to_string(), "a-b-c\nd");
+    EXPECT_EQ(buffer.replace_all("-", " - ", 0), 2);
+    EXPECT_EQ(buffer.to_string(), "a - b - c\nd");
+    EXPECT_TRUE(buffer.segments()[0].empty()); // gap where asked
+    EXPECT_EQ(buffer.replace_all(" ", ""), 4);
+    EXPECT_EQ(buffer.to_string(), "a-b-c\nd");
+    EXPECT_EQ(buffer.segments()[0].size(), 4u); // after the last one
+    EXPECT_EQ(buffer.line_count(), 2);
+
+    EXPECT_EQ(buffer.replace_all("x", "y"), 0);
+    EXPECT_EQ(buffer.replace_all("", "y"), 0);
+    EXPECT_EQ(buffer.to_string(), "a-b-c\nd");
+    // the gap still goes where asked when nothing matches
+    EXPECT_EQ(buffer.replace_all("x", "y", 1), 0);
+    EXPECT_EQ(buffer.segments()[0].size(), 1u);
+    const auto keep = [](std::size_t) -> std::optional<std::string_view> {
+        return std::nullopt;
+    };
+    EXPECT_EQ(buffer.replace_all("x", keep, 6), 0);
+    EXPECT_EQ(buffer.segments()[0].size(), 6u);
+    EXPECT_THROW(buffer.replace_all("x", "y", 8), std::out_of_range);
+    EXPECT_EQ(buffer.to_string(), "a-b-c\nd");
+}
+
+TEST_F(GapBufferTest, ReplaceAllWithCallback) {
+    auto buffer = GapBuffer<char>(std::string_view("x x x x"));
+    buffer.enable_journal();
+
+    // number every other occurrence, keep the rest
+    int n = 0;
+    const std::size_t replaced =
+        buffer.replace_all("x", [&](std::size_t pos) {
+            return pos % 4 == 0 ? std::optional(std::to_string(++n) + "!")
+                                : std::nullopt;
+        });
+    EXPECT_EQ(replaced, 2);
+    EXPECT_EQ(buffer.to_string(), "1! x 2! x");
+
+    EXPECT_TRUE(buffer.undo()); // one step, like any batch
+    EXPECT_EQ(buffer.to_string(), "x x x x");
+}
+
+TEST_F(GapBufferTest, ReplaceAllMatchesStdString) {
+    std::mt19937 rng(22);
+    for (int round = 0; round < 50; ++round) {
+        std::string expected(rng() % 400, 'a');
+        for (char& c : expected) {
+            c = "ab\n"[rng() % 3];
+        }
+        auto buffer = GapBuffer<char>(std::string_view(expected));
+        buffer.insert(buffer.begin() + rng() % (expected.size() + 1), 'a');
+        expected = buffer.to_string();
+
+        const std::string needle(rng() % 3 + 1, 'a');
+        const std::string replacement(rng() % 4, 'c');
+        std::size_t count = 0;
+        for (std::size_t pos = expected.find(needle); pos != std::string::npos;
+             pos = expected.find(needle, pos + replacement.size())) {
+            expected.replace(pos, needle.size(), replacement);
+            ++count;
+        }
+        ASSERT_EQ(buffer.replace_all(needle, replacement), count);
+        ASSERT_EQ(buffer.to_string(), expected);
+    }
+}
+
+TEST_F(GapBufferTest, JournalCoalescesTyping) {
+    auto gb = GapBuffer<char>(std::string_view("hello"));
+    gb.enable_journal();
+    for (const char c : std::string_view(" world")) {
+        gb.insert(gb.end(), c);
+    }
+    gb.push_back('!');
+
+    EXPECT_EQ(gb.get_journal()->record_count(), 1);
+    EXPECT_EQ(gb.get_journal()->arena_size(), 7);
+    EXPECT_TRUE(gb.undo());
+    EXPECT_EQ(gb.to_string(), "hello");
+    EXPECT_FALSE(gb.undo());
+    EXPECT_TRUE(gb.redo());
+    EXPECT_EQ(gb.to_string(), "hello world!");
+    EXPECT_FALSE(gb.redo());
+}
+
+TEST_F(GapBufferTest, JournalCheckpointsAndForks) {
+    auto gb = GapBuffer<char>(std::string_view("abcdef"));
+    gb.enable_journal();
+
+    gb.erase(gb.begin() + 1, 2); // "adef"
+    gb.insert(gb.begin() + 1, std::string_view("XY"));
+    gb.checkpoint();
+    gb.erase(gb.begin()); // "XYdef"
+    gb.checkpoint();
+    gb.insert(gb.begin() + 3, '-');
+    EXPECT_EQ(gb.to_string(), "XYd-ef");
+
+    EXPECT_TRUE(gb.undo());
+    EXPECT_EQ(gb.to_string(), "XYdef");
+    EXPECT_TRUE(gb.undo());
+    EXPECT_EQ(gb.to_string(), "aXYdef");
+    EXPECT_TRUE(gb.undo());
+    EXPECT_EQ(gb.to_string(), "abcdef");
+    EXPECT_TRUE(gb.redo());
+    EXPECT_EQ(gb.to_string(), "aXYdef");
+
+    // a new edit drops what was undone
+    gb.push_back('?');
+    EXPECT_FALSE(gb.redo());
+    EXPECT_TRUE(gb.undo());
+    EXPECT_TRUE(gb.undo());
+    EXPECT_EQ(gb.to_string(), "abcdef");
+    EXPECT_FALSE(gb.undo());
+}
+
+TEST_F(GapBufferTest, JournalUndoesBatchAsOneStep) {
+    using Edit = GapBuffer<char>::Edit;
+    auto gb = GapBuffer<char>(std::string_view("a,b,c"));
+    gb.enable_journal();
+    const std::string_view sep = ", ";
+    const Edit edits[] = {{1, 1, sep}, {3, 1, sep}};
+    gb.apply_batch(edits);
+    EXPECT_EQ(gb.to_string(), "a, b, c");
+
+    EXPECT_TRUE(gb.undo());
+    EXPECT_EQ(gb.to_string(), "a,b,c");
+    EXPECT_TRUE(gb.redo());
+    EXPECT_EQ(gb.to_string(), "a, b, c");
+}
+
+TEST_F(GapBufferTest, JournalMemoryTracksEditsNotDocument) {
+    std::mt19937 rng(3);
+    const std::string original(1 << 20, 'x');
+    auto gb = GapBuffer<char>(std::string_view(original));
+    gb.enable_journal();
+
+    std::vector<size_t> sizes{original.size()};
+    std::string expected = original;
+    for (int i = 0; i < 200; ++i) {
+        const size_t pos = rng() % expected.size();
+        if (rng() % 2 == 0) {
+            const size_t n = std::min<size_t>(3, expected.size() - pos);
+            gb.erase(gb.begin() + pos, n);
+            expected.erase(pos, n);
+        } else {
+            gb.insert(gb.begin() + pos, std::string_view("abc"));
+            expected.insert(pos, "abc");
+        }
+        gb.checkpoint();
+        sizes.push_back(expected.size());
+    }
+    EXPECT_LE(gb.get_journal()->arena_size(), 600);
+
+    for (size_t i = sizes.size() - 1; i > 0; --i) {
+        ASSERT_TRUE(gb.undo());
+        ASSERT_EQ(gb.size(), sizes[i - 1]);
+    }
+    EXPECT_EQ(gb.to_string(), original);
+    while (gb.redo()) {
+    }
+    EXPECT_EQ(gb.to_string(), expected);
+}
+
+// Stateful allocator counting live bytes in its own arena id; copies compare
+// equal, allocators with different ids do not and do not propagate
+template <typename T>
+struct TaggedAllocator {
+    using value_type = T;
+
+    int id = 0;
+    std::shared_ptr<long> live = std::make_shared<long>(0);
+
+    TaggedAllocator() = default;
+    explicit TaggedAllocator(int tag) : id(tag) {
+    }
+
+    T* allocate(std::size_t n) {
+        *live += n;
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* p, std::size_t n) {
+        *live -= n;
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    bool operator==(const TaggedAllocator& other) const {
+        return id == other.id;
+    }
+};
+
+TEST_F(GapBufferTest, StatefulAllocatorIsStoredAndUsed) {
+    using Buffer = GapBuffer<char, TaggedAllocator<char>>;
+    const TaggedAllocator<char> a(1);
+    const TaggedAllocator<char> b(2);
+    {
+        Buffer x(std::string_view("hello"), a);
+        EXPECT_EQ(x.get_allocator().id, 1);
+        EXPECT_EQ(*a.live, static_cast<long>(x.capacity()));
+
+        x.insert(x.end(), std::string_view(" world, hello again"));
+        EXPECT_EQ(*a.live, static_cast<long>(x.capacity()));
+
+        Buffer y(std::string_view("other"), b);
+        y = x; // no propagation: y keeps allocating from b
+        EXPECT_EQ(y.get_allocator().id, 2);
+        EXPECT_EQ(*b.live, static_cast<long>(y.capacity()));
+
+        Buffer z(std::string_view("z"), b);
+        z = std::move(x); // unequal allocators: copies instead of stealing
+        EXPECT_EQ(z.to_string(), "hello world, hello again");
+        EXPECT_EQ(z.get_allocator().id, 2);
+
+        Buffer w(std::move(z)); // move construction takes the allocator
+        EXPECT_EQ(w.get_allocator().id, 2);
+        EXPECT_EQ(w.to_string(), "hello world, hello again");
+    }
+    EXPECT_EQ(*a.live, 0);
+    EXPECT_EQ(*b.live, 0);
+}
+
+TEST_F(GapBufferTest, PmrArena) {
+    std::array<std::byte, 4096> storage;
+    std::pmr::monotonic_buffer_resource arena(
+        storage.data(), storage.size(), std::pmr::null_memory_resource());
+
+    gb::pmr::GapBuffer<char> gb(std::string_view("arena"), &arena);
+    gb.insert(gb.begin() + 5, std::string_view(" backed buffer"));
+    gb.erase(gb.begin(), 6);
+
+    EXPECT_EQ(gb.to_string(), "backed buffer");
+    EXPECT_EQ(gb.get_allocator().resource(), &arena);
+}
+
+TEST_F(GapBufferTest, PoolAllocatorRecyclesBlocks) {
+    gb::BufferPool pool;
+    const gb::PoolAllocator<char> alloc(pool);
+    for (int i = 0; i < 10000; ++i) {
+        GapBuffer<char, gb::PoolAllocator<char>> gb(
+            std::string_view("short lived request buffer"), alloc);
+        gb.insert(gb.end(), std::string_view(" grown past its first block"));
+        ASSERT_EQ(gb.size(), 53);
+    }
+    EXPECT_EQ(pool.slab_count(), 1);
+
+    // the default pool is per thread
+    GapBuffer<char, gb::PoolAllocator<char>> local;
+    EXPECT_EQ(local.get_allocator().resource(),
+              &gb::BufferPool::thread_local_pool());
+}
+
+TEST_F(GapBufferTest, SmallBufferStaysInline) {
+    using Small = GapBuffer<char, TaggedAllocator<char>, GeometricGrowth<>, 64>;
+    const TaggedAllocator<char> alloc(1);
+
+    Small gb(alloc);
+    EXPECT_EQ(gb.capacity(), 64);
+    gb.insert(gb.end(), std::string_view("a short command line"));
+    Small copy = gb;
+    Small moved = std::move(copy);
+    EXPECT_EQ(moved.to_string(), "a short command line");
+    EXPECT_EQ(*alloc.live, 0);
+
+    // spills to the heap past the threshold and comes back after erasing
+    gb.insert(gb.end(), std::string(100, 'x'));
+    EXPECT_GT(*alloc.live, 0);
+    EXPECT_EQ(gb.size(), 120);
+    gb.erase(gb.begin() + 10, gb.end());
+    EXPECT_EQ(gb.to_string(), "a short co");
+    EXPECT_EQ(*alloc.live, 0);
+
+    gb.swap(moved);
+    EXPECT_EQ(gb.to_string(), "a short command line");
+    EXPECT_EQ(moved.to_string(), "a short co");
+}
+
+template <typename T>
+struct SwappedAllocator : TaggedAllocator<T> {
+    using propagate_on_container_swap = std::true_type;
+    using TaggedAllocator<T>::TaggedAllocator;
+};
+
+TEST_F(GapBufferTest, SwapWithInlineBufferDoesNotAllocate) {
+    using Small =
+        GapBuffer<char, SwappedAllocator<char>, GeometricGrowth<>, 16>;
+    const SwappedAllocator<char> a(1);
+    const SwappedAllocator<char> b(2);
+    Small small(std::string_view("inline"), a);
+    Small large(std::string_view(std::string(100, 'x')), b);
+    const long used = *b.live;
+    static_assert(noexcept(small.swap(large)));
+
+    small.swap(large);
+    EXPECT_EQ(small.to_string(), std::string(100, 'x'));
+    EXPECT_EQ(large.to_string(), "inline");
+    EXPECT_EQ(small.get_allocator().id, 2);
+    EXPECT_EQ(large.get_allocator().id, 1);
+    EXPECT_EQ(*a.live, 0);
+    EXPECT_EQ(*b.live, used);
+
+    swap(small, large);
+    EXPECT_EQ(small.to_string(), "inline");
+    EXPECT_EQ(large.to_string(), std::string(100, 'x'));
+    EXPECT_EQ(*a.live, 0);
+}
+
+TEST_F(GapBufferTest, FixedGapBufferNeverAllocates) {
+    FixedGapBuffer<char, 16> gb;
+    gb.insert(gb.end(), std::string_view("0123456789"));
+    gb.insert(gb.begin() + 5, std::string_view("abcdef"));
+    EXPECT_EQ(gb.to_string(), "01234abcdef56789");
+    EXPECT_EQ(gb.capacity(), 16);
+
+    EXPECT_THROW(gb.push_back('!'), std::length_error);
+    EXPECT_EQ(gb.to_string(), "01234abcdef56789");
+
+    using Edit = FixedGapBuffer<char, 16>::Edit;
+    const std::string_view dash = "-";
+    const Edit edits[] = {{0, 5, {}}, {11, 0, dash}};
+    gb.apply_batch(edits);
+    EXPECT_EQ(gb.to_string(), "abcdef-56789");
+
+    std::vector<FixedGapBuffer<char, 16>> cells(3);
+    cells[1].insert(cells[1].end(), std::string_view("cell"));
+    EXPECT_EQ(cells[1].to_string(), "cell");
+}
+
+// Element with a heap-owning member, so every construct/destroy matters
+struct Cell {
+    static inline int live = 0;
+
+    std::string text;
+
+    Cell(std::string s = "") : text(std::move(s)) {
+        ++live;
+    }
+    Cell(const Cell& other) : text(other.text) {
+        ++live;
+    }
+    Cell(Cell&& other) noexcept : text(std::move(other.text)) {
+        ++live;
+    }
+    Cell& operator=(const Cell&) = default;
+    ~Cell() {
+        --live;
+    }
+
+    bool operator==(const Cell&) const = default;
+};
+
+// plain glyph record, relocated with memmove
+struct Glyph {
+    char32_t codepoint;
+    std::uint16_t style;
+};
+
+TEST_F(GapBufferTest, NonTrivialElements) {
+    {
+        GapBuffer<Cell, std::allocator<Cell>, GeometricGrowth<>, 4> cells;
+        std::vector<Cell> expected;
+        std::mt19937 rng(4);
+        for (int i = 0; i < 300; ++i) {
+            const size_t pos = expected.empty() ? 0 : rng() % expected.size();
+            if (rng() % 4 == 0 && !expected.empty()) {
+                cells.erase(cells.begin() + pos);
+                expected.erase(expected.begin() + pos);
+            } else {
+                Cell cell(std::string(20, static_cast<char>('a' + i % 26)));
+                cells.insert(cells.begin() + pos, cell);
+                expected.insert(expected.begin() + pos, cell);
+            }
+        }
+        ASSERT_TRUE(std::equal(cells.begin(), cells.end(), expected.begin(),
+                               expected.end()));
+
+        auto copy = cells;
+        auto moved = std::move(copy);
+        EXPECT_TRUE(std::equal(moved.begin(), moved.end(), expected.begin(),
+                               expected.end()));
+        moved.clear();
+        expected.clear();
+        EXPECT_EQ(Cell::live, static_cast<int>(cells.size()));
+    }
+    EXPECT_EQ(Cell::live, 0);
+}
+
+TEST_F(GapBufferTest, MoveOnlyElements) {
+    GapBuffer<std::unique_ptr<int>> buffer;
+    for (int i = 0; i < 100; ++i) {
+        buffer.push_back(std::make_unique<int>(i));
+    }
+    buffer.insert(buffer.begin() + 10, std::make_unique<int>(-1));
+    buffer.erase(buffer.begin() + 50, buffer.begin() + 60);
+
+    ASSERT_EQ(buffer.size(), 91);
+    EXPECT_EQ(*buffer[9], 9);
+    EXPECT_EQ(*buffer[10], -1);
+    EXPECT_EQ(*buffer[11], 10);
+    EXPECT_EQ(*buffer[50], 59);
+    EXPECT_EQ(*buffer[90], 99);
+
+    auto moved = std::move(buffer);
+    EXPECT_EQ(*moved[10], -1);
+}
+
+TEST_F(GapBufferTest, TriviallyRelocatableElements) {
+    static_assert(gb::is_trivially_relocatable_v<Glyph>);
+    static_assert(!gb::is_trivially_relocatable_v<Cell>);
+
+    GapBuffer<Glyph> glyphs;
+    for (char32_t c = 0; c < 1000; ++c) {
+        glyphs.push_back({c, static_cast<std::uint16_t>(c % 7)});
+    }
+    glyphs.insert(glyphs.begin() + 10, Glyph{U'x', 1});
+    glyphs.erase(glyphs.begin() + 500, glyphs.begin() + 600);
+
+    EXPECT_EQ(glyphs.size(), 901);
+    EXPECT_EQ(glyphs[10].codepoint, U'x');
+    EXPECT_EQ(glyphs[11].codepoint, 10u);
+    EXPECT_EQ(glyphs[600].codepoint, 699u);
+}
+
+TEST_F(GapBufferTest, IteratorSegmentsSplitAtGap) {
+    GapBuffer buffer("hello world");
+    using Iterator = decltype(buffer.begin());
+    static_assert(std::random_access_iterator<Iterator>);
+    static_assert(!std::contiguous_iterator<Iterator>);
+    static_assert(gb::SegmentedIterator<decltype(buffer.cbegin())>);
+
+    buffer.insert(buffer.begin() + 5, ',');
+    ASSERT_EQ(buffer.to_string(), "hello, world");
+
+    const auto [left, right] = buffer.begin().segments(buffer.end());
+    EXPECT_EQ(std::string(left.begin(), left.end()), "hello,");
+    EXPECT_EQ(std::string(right.begin(), right.end()), " world");
+
+    const auto [first, second] =
+        (buffer.begin() + 7).segments(buffer.end() - 1);
+    EXPECT_EQ(std::string(first.begin(), first.end()), "worl");
+    EXPECT_TRUE(second.empty());
+}
+
+TEST_F(GapBufferTest, SegmentedAlgorithms) {
+    GapBuffer<int> numbers;
+    for (int i = 0; i < 1000; ++i) {
+        numbers.push_back(i % 10);
+    }
+    numbers.insert(numbers.begin() + 333, 7); // gap in the middle
+    std::vector<int> expected(numbers.begin(), numbers.end());
+
+    EXPECT_EQ(gb::count(numbers.begin(), numbers.end(), 7),
+              std::count(expected.begin(), expected.end(), 7));
+
+    long sum = 0;
+    gb::for_each(numbers.cbegin(), numbers.cend(), [&](int v) { sum += v; });
+    EXPECT_EQ(sum, 4507);
+
+    std::vector<int> out(numbers.size());
+    EXPECT_EQ(gb::copy(numbers.begin(), numbers.end(), out.begin()),
+              out.end());
+    EXPECT_EQ(out, expected);
+    EXPECT_TRUE(gb::equal(numbers.begin(), numbers.end(), expected.begin(),
+                          expected.end()));
+    EXPECT_TRUE(gb::equal(expected.begin(), expected.end(), numbers.begin()));
+
+    // segmented output with its gap elsewhere than the input's
+    const std::vector<int> zeros(numbers.size());
+    GapBuffer<int> doubled(zeros.begin(), zeros.end());
+    doubled.insert(doubled.begin() + 900, 0);
+    doubled.erase(doubled.begin() + 900);
+    gb::transform(numbers.begin(), numbers.end(), doubled.begin(),
+                  [](int v) { return v * 2; });
+    std::transform(expected.begin(), expected.end(), expected.begin(),
+                   [](int v) { return v * 2; });
+    EXPECT_TRUE(gb::equal(doubled.begin(), doubled.end(), expected.begin()));
+    EXPECT_TRUE(gb::equal(expected.begin(), expected.end(), doubled.begin(),
+                          doubled.end()));
+
+    expected[950] = -1;
+    EXPECT_FALSE(gb::equal(doubled.begin(), doubled.end(), expected.begin()));
+    EXPECT_FALSE(gb::equal(doubled.begin(), doubled.end() - 1,
+                           expected.begin(), expected.end()));
+
+    const GapBuffer text("segmented copy");
+    std::string copied;
+    gb::copy(text.begin(), text.end(), std::back_inserter(copied));
+    EXPECT_EQ(copied, text.to_string());
+}
+
+TEST_F(GapBufferTest, Utf8Kernels) {
+    const auto valid = [](std::string_view s) {
+        const char* end = s.data() + s.size();
+        return gb::utf8::validate(s.data(), end) == end &&
+               gb::utf8::validate<gb::simd::Scalar>(s.data(), end) == end;
+    };
+    EXPECT_TRUE(valid("plain ascii text that spans a few vector widths ..."));
+    EXPECT_TRUE(valid("caf\xC3\xA9 \xE2\x82\xAC \xF0\x9F\x98\x80"));
+    EXPECT_TRUE(valid("\xF4\x8F\xBF\xBF")); // U+10FFFF
+    EXPECT_FALSE(valid("\xC0\xAF"));         // overlong
+    EXPECT_FALSE(valid("\xE0\x80\xAF"));     // overlong
+    EXPECT_FALSE(valid("\xED\xA0\x80"));     // surrogate
+    EXPECT_FALSE(valid("\xF4\x90\x80\x80")); // above U+10FFFF
+    EXPECT_FALSE(valid("abc\xE2\x82"));      // cut off
+    EXPECT_FALSE(valid("\x80"));             // stray continuation
+
+    std::string text;
+    for (int i = 0; i < 50; ++i) {
+        text += "a\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80";
+    }
+    const gb::utf8::Counts expected{200, 250};
+    EXPECT_EQ(gb::utf8::count(text.data(), text.data() + text.size()),
+              expected);
+    EXPECT_EQ(gb::utf8::count<gb::simd::Scalar>(text.data(),
+                                                text.data() + text.size()),
+              expected);
+}
+
+TEST_F(GapBufferTest, Utf8ModeRejectsInvalidEdits) {
+    GapBuffer buffer("caf\xC3\xA9!");
+    buffer.enable_utf8_index();
+    EXPECT_EQ(buffer.code_point_count(), 5);
+
+    // splitting the two byte é, or inserting half of one
+    EXPECT_THROW(buffer.insert(buffer.begin() + 4, 'x'),
+                 std::invalid_argument);
+    EXPECT_THROW(buffer.erase(buffer.begin() + 3, 1), std::invalid_argument);
+    EXPECT_THROW(buffer.insert(buffer.end(), std::string_view("\xC3")),
+                 std::invalid_argument);
+    const std::string bad = "\xFF";
+    const std::array<GapBuffer<>::Edit, 1> batch{{{0, 0, bad}}};
+    EXPECT_THROW(buffer.apply_batch(batch), std::invalid_argument);
+    EXPECT_EQ(buffer.to_string(), "caf\xC3\xA9!");
+    EXPECT_EQ(buffer.code_point_count(), 5);
+
+    buffer.insert(buffer.begin() + 3, std::string_view("\xE2\x82\xAC"));
+    EXPECT_EQ(buffer.to_string(), "caf\xE2\x82\xAC\xC3\xA9!");
+    EXPECT_EQ(buffer.code_point_count(), 6);
+
+    GapBuffer invalid("ab\xC3");
+    EXPECT_THROW(invalid.enable_utf8_index(), std::invalid_argument);
+    EXPECT_FALSE(invalid.has_utf8_index());
+}
+
+TEST_F(GapBufferTest, Utf8IndexMatchesDecodeUnderRandomEdits) {
+    static constexpr std::array<std::string_view, 5> pieces = {
+        "a", "\n", "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80"};
+    GapBuffer buffer;
+    buffer.enable_utf8_index();
+    std::string expected;
+    std::mt19937 rng(17);
+
+    // byte offset of every code point of expected
+    const auto starts = [&] {
+        std::vector<std::size_t> result;
+        for (std::size_t i = 0; i < expected.size(); ++i) {
+            if (!gb::utf8::is_continuation(expected[i])) {
+                result.push_back(i);
+            }
+        }
+        return result;
+    };
+
+    for (int round = 0; round < 200; ++round) {
+        auto points = starts();
+        points.push_back(expected.size());
+        const std::size_t at = points[rng() % points.size()];
+        if (rng() % 4 == 0 && at < expected.size()) {
+            const std::size_t pick = std::lower_bound(points.begin(),
+                                                      points.end(), at) -
+                                     points.begin();
+            const std::size_t last =
+                points[std::min(points.size() - 1, pick + rng() % 3000)];
+            buffer.erase(buffer.begin() + at, buffer.begin() + last);
+            expected.erase(at, last - at);
+        } else {
+            std::string text;
+            for (std::size_t n = rng() % 2000; n > 0; --n) {
+                text += pieces[rng() % pieces.size()];
+            }
+            buffer.insert(buffer.begin() + at, std::string_view(text));
+            expected.insert(at, text);
+        }
+
+        points = starts();
+        ASSERT_EQ(buffer.code_point_count(), points.size());
+        std::size_t utf16 = 0;
+        std::size_t counted = 0; // expected[0, counted) is in utf16
+        for (std::size_t i = 0; i < points.size(); i += 1 + rng() % 200) {
+            for (; counted < points[i]; ++counted) {
+                utf16 += gb::utf8::utf16_units(expected[counted]);
+            }
+            ASSERT_EQ(buffer.code_point_to_offset(i), points[i]);
+            ASSERT_EQ(buffer.offset_to_code_point(points[i]), i);
+            ASSERT_EQ(buffer.offset_to_utf16(points[i]), utf16);
+            ASSERT_EQ(buffer.utf16_to_offset(utf16), points[i]);
+        }
+        ASSERT_EQ(buffer.code_point_to_offset(points.size()), expected.size());
+        ASSERT_EQ(buffer.offset_to_code_point(expected.size()), points.size());
+    }
+    EXPECT_EQ(buffer.to_string(), expected);
+    EXPECT_EQ(buffer.utf16_count(), GapBuffer(expected).utf16_count());
+    EXPECT_THROW(buffer.code_point_to_offset(buffer.code_point_count() + 1),
+                 std::out_of_range);
+}
+
+TEST_F(GapBufferTest, StatsPolicyCountsGapMovesAndGrowth) {
+    using Counted = GapBuffer<char, std::allocator<char>, GeometricGrowth<>,
+                              0, gb::GapStats>;
+
+    Counted buffer(std::string_view("0123456789"));
+    EXPECT_EQ(buffer.stats().gap_moves, 0);
+    EXPECT_EQ(buffer.stats().peak_capacity, 18);
+    EXPECT_EQ(buffer.stats().gap_bytes, 8);
+
+    buffer.insert(buffer.begin() + 2, 'a');  // moves 8 bytes
+    buffer.insert(buffer.begin() + 11, 'b'); // moves 8 back
+    buffer.insert(buffer.begin(), 'c');      // moves 12
+    gb::StatsSnapshot stats = buffer.stats();
+    EXPECT_EQ(stats.gap_moves, 3);
+    EXPECT_EQ(stats.bytes_moved, 28);
+    EXPECT_EQ(stats.move_histogram[3], 3);
+    EXPECT_EQ(stats.reallocations, 0);
+
+    // already at the gap, but too big for it
+    buffer.insert(buffer.begin() + 1, std::string_view("0123456789"));
+    stats = buffer.stats();
+    EXPECT_EQ(stats.gap_moves, 3);
+    EXPECT_EQ(stats.reallocations, 1);
+    EXPECT_EQ(stats.peak_capacity, buffer.capacity());
+    EXPECT_EQ(stats.gap_bytes, buffer.capacity() - buffer.size());
+
+    std::ostringstream dump;
+    dump << stats;
+    EXPECT_NE(dump.str().find("gap moves: 3"), std::string::npos);
+
+    buffer.reset_stats();
+    EXPECT_EQ(buffer.stats().gap_moves, 0);
+}
+
+TEST_F(GapBufferTest, DirtyRangesFollowEdits) {
+    using Range = DirtyRanges::Range;
+    auto buffer = GapBuffer<char>(std::string_view("0123456789abcdef"));
+    EXPECT_EQ(buffer.dirty_ranges(), (std::vector<Range>{{0, 16}}));
+
+    buffer.enable_dirty_tracking();
+    EXPECT_TRUE(buffer.dirty_ranges().empty());
+
+    // a same-length replacement only dirties what it replaced
+    buffer.erase(buffer.begin() + 4, 2);
+    buffer.insert(buffer.begin() + 4, std::string_view("XY"));
+    EXPECT_EQ(buffer.dirty_ranges(), (std::vector<Range>{{4, 2}}));
+
+    buffer.overwrite(12, std::string_view("zz"));
+    EXPECT_EQ(buffer.dirty_ranges(), (std::vector<Range>{{4, 2}, {12, 2}}));
+
+    // an insert shifts everything after it
+    buffer.insert(buffer.begin() + 8, '+');
+    EXPECT_EQ(buffer.dirty_ranges(), (std::vector<Range>{{4, 2}, {8, 9}}));
+    buffer.erase(buffer.begin() + 10);
+    EXPECT_EQ(buffer.dirty_ranges(),
+              (std::vector<Range>{{4, 2}, {8, 2}, {12, 2}}));
+
+    buffer.mark_clean();
+    EXPECT_TRUE(buffer.dirty_ranges().empty());
+    buffer.push_back('!');
+    EXPECT_EQ(buffer.dirty_ranges(), (std::vector<Range>{{16, 1}}));
+
+    EXPECT_THROW(buffer.overwrite(16, std::string_view("ab")),
+                 std::out_of_range);
+}
+
+TEST_F(GapBufferTest, DirtyRangesPatchSavedCopyUnderRandomEdits) {
+    std::mt19937 rng(20);
+    auto buffer = GapBuffer<char>(std::string_view("the quick brown fox"));
+    buffer.enable_dirty_tracking();
+    std::string saved = buffer.to_string();
+
+    for (int round = 0; round < 2000; ++round) {
+        const std::size_t size = buffer.size();
+        const std::size_t at = rng() % (size + 1);
+        switch (rng() % 4) {
+        case 0:
+            buffer.insert(buffer.begin() + at,
+                          std::string(rng() % 4 + 1, 'a' + rng() % 26));
+            break;
+        case 1:
+            buffer.erase(buffer.begin() + at,
+                         std::min<std::size_t>(rng() % 4, size - at));
+            break;
+        case 2: {
+            const std::string text(std::min<std::size_t>(rng() % 4, size - at),
+                                   'A' + rng() % 26);
+            buffer.overwrite(at, text);
+            break;
+        }
+        default: {
+            const std::string text(rng() % 3, '#');
+            const GapBuffer<char>::Edit edit{
+                at, std::min<std::size_t>(rng() % 3, size - at), text};
+            buffer.apply_batch(std::span(&edit, 1));
+            break;
+        }
+        }
+
+        // copying the dirty ranges over the saved copy gives the content
+        std::string patched = saved;
+        patched.resize(buffer.size());
+        const std::string content = buffer.to_string();
+        for (const auto& [offset, length] : buffer.dirty_ranges()) {
+            patched.replace(offset, length, content, offset, length);
+        }
+        ASSERT_EQ(patched, content) << "round " << round;
+        if (round % 50 == 0) {
+            buffer.mark_clean();
+            saved = content;
+        }
+    }
+}
+
+TEST_F(GapBufferTest, SaveIncrementalWritesOnlyChanges) {
+    const std::string path =
+        ::testing::TempDir() + "gapbuffer_incremental_test.txt";
+    std::remove(path.c_str());
+    const auto read = [&path] {
+        std::ifstream in(path);
+        std::stringstream contents;
+        contents << in.rdbuf();
+        return contents.str();
+    };
+
+    auto buffer = GapBuffer<char>(std::string_view("hello world, hello"));
+    EXPECT_EQ(buffer.save_incremental(path), 18); // first save is full
+    EXPECT_TRUE(buffer.has_dirty_tracking());
+    EXPECT_EQ(buffer.save_incremental(path), 0);
+
+    // length preserving: only the changed bytes go out
+    buffer.overwrite(0, std::string_view("J"));
+    buffer.erase(buffer.begin() + 13, 5);
+    buffer.insert(buffer.begin() + 13, std::string_view("there"));
+    EXPECT_EQ(buffer.save_incremental(path), 6);
+    EXPECT_EQ(read(), "Jello world, there");
+
+    // length changing: everything from the first change on
+    buffer.insert(buffer.begin() + 5, ',');
+    EXPECT_EQ(buffer.save_incremental(path), 14);
+    EXPECT_EQ(read(), "Jello, world, there");
+    buffer.erase(buffer.begin() + 12, 7);
+    EXPECT_EQ(buffer.save_incremental(path), 0);
+    EXPECT_EQ(read(), "Jello, world");
+
+    // a file changed behind our back is saved in full
+    {
+        std::ofstream out(path);
+        out << "something else";
+    }
+    buffer.overwrite(0, std::string_view("H"));
+    EXPECT_EQ(buffer.save_incremental(path), 12);
+    EXPECT_EQ(read(), "Hello, world");
+    std::remove(path.c_str());
+}
+
+TEST_F(GapBufferTest, SessionRoundTrip) {
+    const std::string path = ::testing::TempDir() + "gapbuffer_session.bin";
+    GapBuffer<char> buffer(std::string_view("one\ntwo\nthree\n"));
+    buffer.enable_journal();
+    buffer.enable_line_index();
+    buffer.enable_utf8_index();
+    buffer.insert(buffer.begin() + 4, std::string_view("1.5\n"));
+    buffer.checkpoint();
+    buffer.erase(buffer.begin(), 4);
+    buffer.checkpoint();
+    buffer.insert(buffer.begin() + 8, std::string_view("2.5\n")); // gap here
+    buffer.undo();
+    const auto [prefix, suffix] = buffer.segments();
+    buffer.save_session(path);
+
+    auto loaded = GapBuffer<char>::load_session(path);
+    EXPECT_EQ(loaded.to_string(), "1.5\ntwo\nthree\n");
+    EXPECT_EQ(loaded.capacity(), buffer.capacity());
+    EXPECT_EQ(loaded.segments()[0].size(), prefix.size());
+    EXPECT_EQ(loaded.segments()[1].size(), suffix.size());
+    EXPECT_TRUE(loaded.has_line_index());
+    EXPECT_TRUE(loaded.has_utf8_index());
+    EXPECT_EQ(loaded.line_count(), 4);
+    EXPECT_EQ(loaded.line_to_offset(2), 8);
+
+    EXPECT_TRUE(loaded.redo());
+    EXPECT_EQ(loaded.to_string(), "1.5\ntwo\n2.5\nthree\n");
+    EXPECT_TRUE(loaded.undo());
+    EXPECT_TRUE(loaded.undo());
+    EXPECT_TRUE(loaded.undo());
+    EXPECT_FALSE(loaded.undo());
+    EXPECT_EQ(loaded.to_string(), "one\ntwo\nthree\n");
+    EXPECT_EQ(loaded.line_count(), 4);
+
+    // without extras, and with a wider element type
+    const std::vector<int> values = {1, 2, 3};
+    GapBuffer<int> numbers(values.begin(), values.end());
+    numbers.insert(numbers.begin() + 1, 7);
+    numbers.save_session(path);
+    const auto loadedNumbers = GapBuffer<int>::load_session(path);
+    EXPECT_TRUE(std::ranges::equal(loadedNumbers, std::vector{1, 7, 2, 3}));
+    EXPECT_EQ(loadedNumbers.segments()[0].size(), 2);
+    EXPECT_EQ(loadedNumbers.get_journal(), nullptr);
+    EXPECT_FALSE(loadedNumbers.has_line_index());
+
+    // a reserve far beyond the content is saved, but not allocated again
+    GapBuffer<char> reserved(32 << 20);
+    reserved.insert(reserved.begin(), std::string_view("hello"));
+    reserved.save_session(path);
+    const auto loadedReserved = GapBuffer<char>::load_session(path);
+    EXPECT_EQ(loadedReserved.to_string(), "hello");
+    EXPECT_LT(loadedReserved.capacity(), 1024);
+    GapBuffer<char> resized;
+    resized.resize(20 << 20);
+    resized.push_back('!');
+    resized.save_session(path);
+    const auto loadedResized = GapBuffer<char>::load_session(path);
+    EXPECT_EQ(loadedResized.to_string(), "!");
+    EXPECT_LT(loadedResized.capacity(), 1024);
+    std::remove(path.c_str());
+}
+
+TEST_F(GapBufferTest, SessionRejectsDamagedFiles) {
+    const std::string path = ::testing::TempDir() + "gapbuffer_session.bin";
+    GapBuffer<char> buffer(std::string_view("some text\nmore text\n"));
+    buffer.enable_line_index();
+    buffer.enable_journal();
+    buffer.insert(buffer.begin() + 4, std::string_view(" old"));
+    buffer.save_session(path);
+    std::string saved;
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::stringstream contents;
+        contents << in.rdbuf();
+        saved = contents.str();
+    }
+    const auto loadFrom = [&path](const std::string& bytes) {
+        std::ofstream(path, std::ios::binary) << bytes;
+        return GapBuffer<char>::load_session(path);
+    };
+    EXPECT_EQ(loadFrom(saved).to_string(), "some old text\nmore text\n");
+
+    using gb::session::Header;
+    const Header header = [&saved] {
+        Header h;
+        std::memcpy(&h, saved.data(), sizeof(h));
+        return h;
+    }();
+    const gb::session::Layout layout = gb::session::layout(header);
+    std::string flipped = saved;
+    flipped[sizeof(Header) + 3] ^= 1; // content
+    EXPECT_THROW(loadFrom(flipped), std::runtime_error);
+    flipped = saved;
+    flipped[layout.line_blocks] ^= 1;
+    EXPECT_THROW(loadFrom(flipped), std::runtime_error);
+    flipped = saved;
+    flipped[offsetof(Header, journal_applied)] ^= 1; // header fields count
+    EXPECT_THROW(loadFrom(flipped), std::runtime_error);
+
+    // well sealed files that still make no sense
+    const auto reseal = [](std::string bytes, const auto& change) {
+        Header h;
+        std::memcpy(&h, bytes.data(), sizeof(h));
+        change(h, bytes);
+        std::memcpy(bytes.data(), &h, sizeof(h));
+        h.checksum = gb::session::checksum(
+            gb::session::locate(std::as_bytes(std::span(bytes)), 1));
+        std::memcpy(bytes.data(), &h, sizeof(h));
+        return bytes;
+    };
+    const auto setWord = [](std::string& bytes, std::size_t at,
+                            std::uint64_t value) {
+        std::memcpy(bytes.data() + at, &value, sizeof(value));
+    };
+    EXPECT_NO_THROW(loadFrom(reseal(saved, [](Header&, std::string&) {})));
+    EXPECT_LT(loadFrom(reseal(saved,
+                              [](Header& h, std::string&) {
+                                  h.capacity = std::uint64_t{1} << 40;
+                              }))
+                  .capacity(),
+              64); // not worth restoring
+    EXPECT_THROW(loadFrom(reseal(saved,
+                                 [&](Header&, std::string& bytes) {
+                                     setWord(bytes, layout.line_blocks, 1);
+                                 })),
+                 std::runtime_error);
+    EXPECT_THROW(loadFrom(reseal(saved,
+                                 [&](Header&, std::string& bytes) {
+                                     setWord(bytes,
+                                             layout.journal_records + 3 * 8,
+                                             1000); // data
+                                 })),
+                 std::runtime_error);
+    EXPECT_THROW(loadFrom(reseal(saved,
+                                 [&](Header&, std::string& bytes) {
+                                     setWord(bytes, layout.journal_records,
+                                             1000); // offset
+                                 })),
+                 std::runtime_error);
+    EXPECT_THROW(loadFrom(reseal(saved,
+                                 [&](Header&, std::string& bytes) {
+                                     setWord(bytes,
+                                             layout.journal_records + 4 * 8,
+                                             0); // group start
+                                 })),
+                 std::runtime_error);
+    EXPECT_THROW(loadFrom(saved.substr(0, saved.size() - 8)),
+                 std::runtime_error);
+    EXPECT_THROW(loadFrom(saved.substr(0, 10)), std::runtime_error);
+    EXPECT_THROW(loadFrom("hello world"), std::runtime_error);
+    loadFrom(saved);
+    EXPECT_THROW(GapBuffer<char16_t>::load_session(path), std::runtime_error);
+    std::remove(path.c_str());
+}
+
+TEST_F(GapBufferTest, DiffTurnsOneBufferIntoAnother) {
+    GapBuffer<char> before(std::string_view("the quick brown fox jumps"));
+    GapBuffer<char> after(std::string_view("the quick red fox jumped"));
+    before.insert(before.begin() + 3, ' ');
+    before.erase(before.begin() + 3, 1); // gap inside the common prefix
+    after.insert(after.begin() + 12, 'd');
+    after.erase(after.begin() + 12, 1); // gap inside an insert
+
+    const auto edits = gb::diff(before, after);
+    EXPECT_EQ(edits.size(), 4); // "brown" -> "red", split at the gap
+    auto patched = before;
+    patched.apply_batch(edits);
+    EXPECT_EQ(patched.to_string(), after.to_string());
+
+    EXPECT_TRUE(gb::diff(before, before).empty());
+    const GapBuffer<char> empty;
+    patched = before;
+    patched.apply_batch(gb::diff(before, empty));
+    EXPECT_EQ(patched.size(), 0);
+    patched.apply_batch(gb::diff(patched, after));
+    EXPECT_EQ(patched.to_string(), after.to_string());
+}
+
+TEST_F(GapBufferTest, DiffIsMinimalAndCorrect) {
+    std::mt19937 rng(23);
+    const auto random_text = [&rng](std::size_t length) {
+        std::string text;
+        for (std::size_t i = 0; i < length; ++i) {
+            text += static_cast<char>('a' + rng() % 3);
+        }
+        return text;
+    };
+    const auto lcs = [](const std::string& a, const std::string& b) {
+        std::vector<std::size_t> row(b.size() + 1), next(b.size() + 1);
+        for (std::size_t i = a.size(); i-- > 0;) {
+            for (std::size_t j = b.size(); j-- > 0;) {
+                next[j] = a[i] == b[j] ? row[j + 1] + 1
+                                       : std::max(row[j], next[j + 1]);
+            }
+            std::swap(row, next);
+        }
+        return row[0];
+    };
+
+    for (int round = 0; round < 400; ++round) {
+        const std::string a = random_text(rng() % 40);
+        std::string b = a;
+        for (std::size_t edits = rng() % 6; edits > 0; --edits) {
+            const std::size_t at = b.empty() ? 0 : rng() % b.size();
+            b.replace(at, std::min<std::size_t>(rng() % 4, b.size() - at),
+                      random_text(rng() % 4));
+        }
+        GapBuffer<char> from{std::string_view(a)};
+        GapBuffer<char> to{std::string_view(b)};
+        from.insert(from.begin() + rng() % (a.size() + 1), 'x');
+        from.erase(from.begin() + rng() % from.size(), 1);
+        from.insert(from.begin() + rng() % (from.size() + 1), 'x');
+        from.erase(from.begin() + (from.size() - 1), 1); // gap near end
+        const std::string source = from.to_string();
+        to.insert(to.begin() + rng() % (b.size() + 1), 'y');
+        to.erase(to.begin() + rng() % to.size(), 1);
+        const std::string target = to.to_string();
+
+        const auto edits = gb::diff(from, to);
+        std::size_t cost = 0;
+        for (const auto& edit : edits) {
+            cost += edit.erase + edit.insert.size();
+        }
+        EXPECT_EQ(cost, source.size() + target.size() -
+                            2 * lcs(source, target))
+            << source << " -> " << target;
+        auto patched = from;
+        patched.apply_batch(edits);
+        ASSERT_EQ(patched.to_string(), target);
+
+        // capped searches give up minimality, never correctness
+        patched = from;
+        patched.apply_batch(gb::diff(from, to, 1));
+        ASSERT_EQ(patched.to_string(), target);
+    }
+}
+
+TEST_F(GapBufferTest, ThreadPoolRunsEveryItemOnce) {
+    gb::ThreadPool pool(3);
+    std::vector<std::atomic<int>> hits(1000);
+    pool.run(hits.size(), [&hits](std::size_t i) { ++hits[i]; });
+    EXPECT_TRUE(std::all_of(hits.begin(), hits.end(),
+                            [](const std::atomic<int>& h) { return h == 1; }));
+
+    std::atomic<int> calls = 0;
+    EXPECT_THROW(pool.run(100,
+                          [&calls](std::size_t i) {
+                              ++calls;
+                              if (i == 42) {
+                                  throw std::runtime_error("item 42");
+                              }
+                          }),
+                 std::runtime_error);
+    EXPECT_GE(calls, 1);
+    pool.run(0, [](std::size_t) { FAIL(); });
+}
+
+TEST_F(GapBufferTest, ParallelAlgorithmsMatchSequential) {
+    std::mt19937 rng(25);
+    std::string text;
+    for (int i = 0; i < 50000; ++i) {
+        text += static_cast<char>("abc \n"[rng() % 5]);
+    }
+    GapBuffer<char> buffer{std::string_view(text)};
+    buffer.insert(buffer.begin() + 20011, 'Z'); // gap mid-tile
+    text.insert(20011, 1, 'Z');
+
+    gb::ThreadPool pool(3);
+    for (const std::size_t tileBytes : {1, 7, 4096, 1 << 20}) {
+        const gb::parallel::Options options{&pool, tileBytes};
+        EXPECT_EQ(gb::parallel::count(buffer, '\n', options),
+                  std::count(text.begin(), text.end(), '\n'));
+        EXPECT_EQ(gb::parallel::find_first(buffer, 'Z', options), 20011);
+        EXPECT_EQ(gb::parallel::find_first(buffer, 'q', options),
+                  gb::parallel::npos);
+        EXPECT_EQ(gb::parallel::find_first_if(
+                      buffer, [](char c) { return c == 'c'; }, options),
+                  text.find('c'));
+        const std::string joined = gb::parallel::reduce(
+            buffer, std::string(),
+            [](std::span<const char> tile, std::size_t) {
+                return std::string(tile.begin(), tile.end());
+            },
+            std::plus<>(), options);
+        EXPECT_EQ(joined, text);
+
+        // needles cut by tile ends and by the gap
+        for (int i = 0; i < 40; ++i) {
+            const std::size_t at = i < 5 ? 20008 + i : rng() % text.size();
+            const std::string needle =
+                text.substr(at, 1 + rng() % 12);
+            EXPECT_EQ(gb::parallel::find_first(buffer, needle, options),
+                      text.find(needle))
+                << needle << " tile " << tileBytes;
+        }
+        EXPECT_EQ(gb::parallel::find_first(buffer, "qq", options),
+                  gb::parallel::npos);
+    }
+
+    gb::parallel::transform(
+        buffer, [](char c) { return c == ' ' ? '_' : c; }, {&pool, 999});
+    std::replace(text.begin(), text.end(), ' ', '_');
+    EXPECT_EQ(buffer.to_string(), text);
+}
+
+TEST_F(GapBufferTest, ParallelValidateUtf8) {
+    std::mt19937 rng(8);
+    const std::vector<std::string> pieces = {"a", "\xC3\xA9", "\xE2\x82\xAC",
+                                             "\xF0\x9F\x98\x80", "\n"};
+    gb::ThreadPool pool(2);
+    for (int round = 0; round < 200; ++round) {
+        std::string text;
+        while (text.size() < 300) {
+            text += pieces[rng() % pieces.size()];
+        }
+        if (round % 2 == 1) { // break it somewhere
+            text[rng() % text.size()] = static_cast<char>(rng() % 256);
+        }
+        const char* end = text.data() + text.size();
+        const char* bad = gb::utf8::validate(text.data(), end);
+        const std::size_t expected =
+            bad == end ? gb::parallel::npos : bad - text.data();
+
+        GapBuffer<char> buffer{std::string_view(text)};
+        const std::size_t gapAt = rng() % text.size();
+        buffer.insert(buffer.begin() + gapAt, 'x');
+        buffer.erase(buffer.begin() + gapAt, 1);
+        const gb::parallel::Options options{&pool, 1 + rng() % 9};
+        EXPECT_EQ(gb::parallel::validate_utf8(buffer, options), expected)
+            << "round " << round;
+    }
+}
+
+TEST_F(GapBufferTest, PatternSetScansAcrossGap) {
+    using Match = gb::PatternSet::Match;
+    const gb::PatternSet patterns({
+        gb::Pattern::literal("hello"),
+        gb::Pattern::regex("l+o"),
+        gb::Pattern::literal("o, w"),
+        gb::Pattern::regex(R"(\bw\w*)"),
+        gb::Pattern::literal("l"),
+    });
+
+    const auto buffer = searchBuffer(); // "hello, |gap| world, hello"
+    const std::vector<Match> expected = {
+        {0, 0, 5},  {4, 2, 1},  {1, 2, 3}, {4, 3, 1},  {2, 4, 4},
+        {3, 7, 5},  {4, 10, 1}, {0, 14, 5}, {4, 16, 1}, {1, 16, 3},
+        {4, 17, 1},
+    };
+    const std::vector<Match> matches = patterns.find_all(buffer);
+    std::vector<Match> sorted = expected;
+    std::sort(sorted.begin(), sorted.end(), [](const Match& a, const Match& b) {
+        return std::tie(a.offset, a.pattern) < std::tie(b.offset, b.pattern);
+    });
+    EXPECT_EQ(matches, sorted);
+    EXPECT_EQ(matches, patterns.find_all(buffer.to_string()));
+
+    // byte by byte through a Scanner finds the same
+    gb::PatternSet::Scanner scanner(patterns);
+    std::vector<Match> streamed;
+    const auto collect = [&](const Match& match) { streamed.push_back(match); };
+    for (const char c : buffer.to_string()) {
+        scanner.feed(std::string_view(&c, 1), collect);
+    }
+    scanner.finish(collect);
+    std::sort(streamed.begin(), streamed.end(),
+              [](const Match& a, const Match& b) {
+                  return std::tie(a.offset, a.pattern) <
+                         std::tie(b.offset, b.pattern);
+              });
+    EXPECT_EQ(streamed, matches);
+}
+
+TEST_F(GapBufferTest, PatternSetRegexSyntax) {
+    using Match = gb::PatternSet::Match;
+    const auto find = [](std::string_view regex, std::string_view text) {
+        std::vector<std::pair<std::size_t, std::size_t>> found;
+        for (const Match& match :
+             gb::PatternSet({gb::Pattern::regex(regex)}).find_all(text)) {
+            found.emplace_back(match.offset, match.length);
+        }
+        return found;
+    };
+    using Found = std::vector<std::pair<std::size_t, std::size_t>>;
+
+    EXPECT_EQ(find("^#.*$", "#a\nb #c\n#d"), (Found{{0, 2}, {8, 2}}));
+    EXPECT_EQ(find(R"(\d{2,3})", "1 12 1234 12345"),
+              (Found{{2, 2}, {5, 3}, {10, 3}, {13, 2}}));
+    EXPECT_EQ(find("[^a-c\\]]+", "ab]xyz-c"), (Found{{3, 4}}));
+    EXPECT_EQ(find(R"(\x41\.\B)", "A.. A.x"), (Found{{0, 2}}));
+    EXPECT_EQ(find("a|ab|abc", "abcab"), (Found{{0, 3}, {3, 2}}));
+    EXPECT_EQ(find("x*", "abc"), Found{}); // empty matches are skipped
+
+    for (const char* bad : {"(a", "a)", "*a", "[ab", "a{2,1}", "\\q", "a{"}) {
+        EXPECT_THROW(gb::PatternSet({gb::Pattern::regex(bad)}),
+                     std::invalid_argument)
+            << bad;
+    }
+    EXPECT_THROW(gb::PatternSet({gb::Pattern::literal("")}),
+                 std::invalid_argument);
+}
+
+// Leftmost-longest, non-overlapping matches by brute force: the longest
+// full match at the first start that has one, then again after it
+static std::vector<std::pair<std::size_t, std::size_t>>
+bruteForceMatches(const std::regex& re, const std::string& text) {
+    std::vector<std::pair<std::size_t, std::size_t>> found;
+    std::size_t pos = 0;
+    while (pos < text.size()) {
+        bool matched = false;
+        for (std::size_t start = pos; start < text.size() && !matched;
+             ++start) {
+            for (std::size_t end = text.size(); end > start; --end) {
+                if (std::regex_match(text.begin() + start, text.begin() + end,
+                                     re)) {
+                    found.emplace_back(start, end - start);
+                    pos = end;
+                    matched = true;
+                    break;
+                }
+            }
+        }
+        if (!matched) {
+            break;
+        }
+    }
+    return found;
+}
+
+TEST_F(GapBufferTest, PatternSetBoundsRegexLookahead) {
+    using Match = gb::PatternSet::Match;
+    // a pending "a" keeps a.*b looking for a b that never comes
+    const gb::PatternSet set({gb::Pattern::regex("a.*b|a")}, 16);
+    gb::PatternSet::Scanner scanner(set);
+    const std::string run(1000, 'a');
+    std::size_t matches = 0;
+    std::size_t mostBuffered = 0;
+    for (int i = 0; i < 200; ++i) {
+        scanner.feed(run, [&](const Match& match) {
+            matches += match.length == 1;
+        });
+        mostBuffered = std::max(mostBuffered, scanner.buffered());
+    }
+    scanner.finish([&](const Match&) { ++matches; });
+    EXPECT_EQ(matches, 200000);
+    EXPECT_LT(mostBuffered, 16384);
+
+    // within the look-ahead the longest match still wins
+    const std::string text = "a" + std::string(100, 'a') + "b";
+    EXPECT_EQ(set.find_all("aaaab"), (std::vector<Match>{{0, 0, 5}}));
+    EXPECT_EQ(gb::PatternSet({gb::Pattern::regex("a.*b|a")}).find_all(text),
+              (std::vector<Match>{{0, 0, 102}}));
+    EXPECT_EQ(set.find_all(text).back().length, 17);
+}
+
+TEST_F(GapBufferTest, PatternSetMatchesBruteForce) {
+    const std::vector<std::string> regexes = {
+        "a(b|c)*d", "[ab]+",    "ab|abc|b", "(a|ab)(c|bcd)",
+        "c?a+b?",   "a.c",      "b{2,3}",   "(ab|a)*c",
+        "d(a|b)?d", "(a*b)+",   "[^ab]c",   "a{2}|a+b",
+    };
+    std::vector<gb::Pattern> patterns;
+    for (const std::string& regex : regexes) {
+        patterns.push_back(gb::Pattern::regex(regex));
+    }
+    const gb::PatternSet set(patterns);
+
+    std::mt19937 rng(21);
+    for (int round = 0; round < 60; ++round) {
+        std::string text(40, ' ');
+        for (char& c : text) {
+            c = "abcd"[rng() % 4];
+        }
+        auto buffer = GapBuffer<char>(std::string_view(text));
+        buffer.insert(buffer.begin() + rng() % text.size(), 'a');
+        buffer.erase(buffer.begin() + rng() % text.size());
+        text = buffer.to_string();
+
+        std::vector<std::vector<std::pair<std::size_t, std::size_t>>> got(
+            regexes.size());
+        for (const auto& match : set.find_all(buffer)) {
+            got[match.pattern].emplace_back(match.offset, match.length);
+        }
+        for (std::size_t i = 0; i < regexes.size(); ++i) {
+            ASSERT_EQ(got[i], bruteForceMatches(std::regex(regexes[i]), text))
+                << regexes[i] << " in " << text;
+        }
+    }
 }
 
 /*
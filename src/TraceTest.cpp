@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+
+#include "trace.h"
+using namespace ::testing;
+
+class TraceTest : public Test {
+public:
+};
+
+TEST_F(TraceTest, ParsesEditingTraceJson) {
+    const gb::trace::Trace trace = gb::trace::parse_json(R"({
+        "startContent": "ab",
+        "endContent": "xa\"\n",
+        "txns": [
+            {"time": "2020-01-01", "patches": [[0, 0, "x"], [2, 1, ""]]},
+            {"time": "2020-01-02", "patches": [[2, 0, "\"\n"]]}
+        ]
+    })");
+
+    EXPECT_EQ(trace.start, "ab");
+    ASSERT_TRUE(trace.end.has_value());
+    EXPECT_EQ(*trace.end, "xa\"\n");
+    ASSERT_EQ(trace.ops.size(), 3);
+    EXPECT_EQ(trace.ops[0], (gb::trace::Op{0, 0, "x"}));
+    EXPECT_EQ(trace.ops[1], (gb::trace::Op{2, 1, ""}));
+    EXPECT_EQ(trace.ops[2], (gb::trace::Op{2, 0, "\"\n"}));
+}
+
+TEST_F(TraceTest, CodePointPositionsBecomeByteOffsets) {
+    // é is one code point but two bytes, 😀 (a surrogate pair in JSON)
+    // four
+    const gb::trace::Trace trace = gb::trace::parse_json(R"({
+        "startContent": "café",
+        "edits": [[4, 0, "😀!"], [3, 1, "e"], [5, 0, "?"]]
+    })");
+
+    EXPECT_EQ(trace.start, "caf\xC3\xA9");
+    ASSERT_EQ(trace.ops.size(), 3);
+    EXPECT_EQ(trace.ops[0], (gb::trace::Op{5, 0, "\xF0\x9F\x98\x80!"}));
+    EXPECT_EQ(trace.ops[1], (gb::trace::Op{3, 2, "e"}));
+    EXPECT_EQ(trace.ops[2], (gb::trace::Op{8, 0, "?"}));
+}
+
+TEST_F(TraceTest, BinaryRoundTrip) {
+    gb::trace::Trace trace;
+    trace.start = std::string("with\0nul", 8);
+    trace.end = "done";
+    trace.ops = {{0, 3, "abc"}, {7, 0, std::string(1000, 'z')}, {1, 1, ""}};
+
+    const gb::trace::Trace copy =
+        gb::trace::parse_binary(gb::trace::to_binary(trace));
+    EXPECT_EQ(copy.start, trace.start);
+    EXPECT_EQ(copy.end, trace.end);
+    EXPECT_EQ(copy.ops, trace.ops);
+
+    std::string truncated = gb::trace::to_binary(trace);
+    truncated.pop_back();
+    EXPECT_THROW(gb::trace::parse_binary(truncated), std::runtime_error);
+}
+
+TEST_F(TraceTest, RejectsMalformedTraces) {
+    EXPECT_THROW(gb::trace::parse_json("[]"), std::runtime_error);
+    EXPECT_THROW(gb::trace::parse_json(R"({"edits": [[0, 0]]})"),
+                 std::runtime_error);
+    EXPECT_THROW(gb::trace::parse_json(R"({"edits": [[0, 0, "a"]])"),
+                 std::runtime_error);
+    EXPECT_THROW(gb::trace::parse_json(R"({"edits": [[0, 0, "\ud83d"]]})"),
+                 std::runtime_error);
+    // past the end of the text, in code points
+    EXPECT_THROW(gb::trace::parse_json(R"({"edits": [[2, 0, "é"]]})"),
+                 std::runtime_error);
+    // and in bytes, for ASCII and binary traces
+    EXPECT_THROW(gb::trace::parse_json(R"({"startContent": "abc",
+        "txns": [{"patches": [[100, 5, "xyz"]]}]})"),
+                 std::runtime_error);
+    gb::trace::Trace trace;
+    trace.start = "abc";
+    trace.ops = {{1, 1, "xy"}, {2, 2, ""}};
+    EXPECT_NO_THROW(gb::trace::parse_binary(gb::trace::to_binary(trace)));
+    trace.ops[1].erase = 3;
+    EXPECT_THROW(gb::trace::parse_binary(gb::trace::to_binary(trace)),
+                 std::runtime_error);
+}
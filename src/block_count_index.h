@@ -0,0 +1,206 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "fenwick_tree.h"
+
+// Per-block counts of some unit of text (newlines, code points, ...),
+// indexed by one Fenwick tree for the bytes per block and one per counted
+// field. Locating the block that holds an offset or the n-th unit is
+// O(log blocks); the caller then scans at most one block. LineIndex and
+// Utf8Index add their queries on top.
+//
+// Counter describes the unit: units_type is what a block counts (with +=
+// and -=, adding up across any byte split of the text), and
+// field(units, i) reads its i-th of `fields` members.
+//
+// The index holds no text. Whenever it needs counts it calls
+// count(from, length) against the buffer it mirrors.
+template <typename Counter>
+class BlockCountIndex {
+public:
+    using size_type = std::size_t;
+    using Units = typename Counter::units_type;
+
+    // blocks are split above twice this size and merged below a quarter
+    static constexpr size_type block_size = 4096;
+
+    struct Block {
+        size_type bytes;
+        Units units;
+    };
+
+    BlockCountIndex() = default;
+
+    // Take back blocks saved through block_list()
+    explicit BlockCountIndex(std::vector<Block> saved)
+        : blocks(std::move(saved)) {
+        rebuild();
+    }
+
+    template <typename Count>
+    BlockCountIndex(const size_type length, Count&& count) {
+        for (size_type from = 0; from < length; from += block_size) {
+            const size_type bytes = std::min(block_size, length - from);
+            blocks.push_back({bytes, count(from, bytes)});
+        }
+        rebuild();
+    }
+
+    void clear() {
+        blocks.clear();
+        rebuild();
+    }
+
+    // text of `length` bytes was inserted at offset
+    template <typename Count>
+    void insert(const size_type offset, const size_type length,
+                Count&& count) {
+        if (length == 0) {
+            return;
+        }
+        if (blocks.empty()) {
+            blocks.push_back({0, Units{}});
+            rebuild();
+        }
+
+        auto [index, _] = bytes.find(offset);
+        if (index == blocks.size()) {
+            --index; // appending extends the last block
+        }
+        const Units added = count(offset, length);
+        blocks[index].bytes += length;
+        blocks[index].units += added;
+
+        if (blocks[index].bytes <= 2 * block_size) {
+            bytes.add(index, length);
+            for (size_type i = 0; i < Counter::fields; ++i) {
+                counts[i].add(index, Counter::field(added, i));
+            }
+            return;
+        }
+
+        // split the grown block into block_size pieces
+        size_type from = bytes.prefix(index);
+        size_type left = blocks[index].bytes;
+        std::vector<Block> pieces;
+        while (left > 0) {
+            const size_type n = std::min(block_size, left);
+            pieces.push_back({n, count(from, n)});
+            from += n;
+            left -= n;
+        }
+        blocks.erase(blocks.begin() + index);
+        blocks.insert(blocks.begin() + index, pieces.begin(), pieces.end());
+        rebuild();
+    }
+
+    // `length` bytes at offset are about to be erased; count still sees them
+    template <typename Count>
+    void erase(const size_type offset, size_type length, Count&& count) {
+        if (length == 0) {
+            return;
+        }
+
+        auto [index, inBlock] = bytes.find(offset);
+        const size_type first = index;
+        size_type from = offset;
+        bool structural = false;
+        while (length > 0) {
+            Block& block = blocks[index];
+            const size_type n = std::min(length, block.bytes - inBlock);
+            const Units removed = count(from, n);
+            block.bytes -= n;
+            block.units -= removed;
+            from += n;
+            length -= n;
+            inBlock = 0;
+            if (!structural) {
+                bytes.add(index, static_cast<size_type>(0) - n);
+                for (size_type i = 0; i < Counter::fields; ++i) {
+                    counts[i].add(index, static_cast<size_type>(0) -
+                                             Counter::field(removed, i));
+                }
+            }
+            if (block.bytes == 0) {
+                blocks.erase(blocks.begin() + index);
+                structural = true;
+            } else {
+                ++index;
+            }
+        }
+
+        // counts simply add up, so merging needs no rescan
+        if (first < blocks.size() && blocks[first].bytes < block_size / 4) {
+            if (first + 1 < blocks.size()) {
+                blocks[first].bytes += blocks[first + 1].bytes;
+                blocks[first].units += blocks[first + 1].units;
+                blocks.erase(blocks.begin() + first + 1);
+                structural = true;
+            } else if (first > 0) {
+                blocks[first - 1].bytes += blocks[first].bytes;
+                blocks[first - 1].units += blocks[first].units;
+                blocks.erase(blocks.begin() + first);
+                structural = true;
+            }
+        }
+        if (structural) {
+            rebuild();
+        }
+    }
+
+    std::span<const Block> block_list() const noexcept {
+        return blocks;
+    }
+
+protected:
+    size_type total(const size_type field) const {
+        return counts[field].total();
+    }
+
+    // Start offset of the block holding the n-th unit of field (0 based,
+    // below total(field)), and n's rank among the units of the block
+    std::pair<size_type, size_type> locate_unit(const size_type field,
+                                                const size_type n) const {
+        const auto [index, rank] = counts[field].find(n);
+        return {bytes.prefix(index), rank};
+    }
+
+    // Index and start offset of the block holding offset
+    std::pair<size_type, size_type> block_at(const size_type offset) const {
+        const auto [index, _] = bytes.find(offset);
+        return {index, bytes.prefix(index)};
+    }
+
+    // units of field in the blocks before index
+    size_type units_before(const size_type field,
+                           const size_type index) const {
+        return counts[field].prefix(index);
+    }
+
+private:
+    void rebuild() {
+        std::vector<size_type> values;
+        values.reserve(blocks.size());
+        for (const Block& block : blocks) {
+            values.push_back(block.bytes);
+        }
+        bytes.assign(values);
+        for (size_type i = 0; i < Counter::fields; ++i) {
+            values.clear();
+            for (const Block& block : blocks) {
+                values.push_back(Counter::field(block.units, i));
+            }
+            counts[i].assign(values);
+        }
+    }
+
+    std::vector<Block> blocks;
+    FenwickTree<size_type> bytes;
+    std::array<FenwickTree<size_type>, Counter::fields> counts;
+};
@@ -0,0 +1,621 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "fenwick_tree.h"
+#include "file_io.h"
+#include "gapbuffer.h"
+#include "mapped_file.h"
+
+// Sequence of gap buffers holding at most ChunkSize elements each. A Fenwick
+// tree over the chunk sizes locates any position in O(log chunks), so edits,
+// growth and gap moves only touch one chunk instead of the whole document.
+// Structural changes (splitting or merging chunks) shift chunk handles and
+// rebuild the index, which is O(chunks) but happens once per ChunkSize
+// elements inserted or erased.
+//
+// open_mapped() serves a file straight from a read-only mapping: chunks are
+// views into it until the first write, which copies just that chunk into
+// owned storage. Const access never materializes a chunk, non-const access
+// (at, iterator) does.
+//
+// Owned chunks are shared copy-on-write between copies of a buffer, so
+// copying is O(chunks) and snapshot() hands out an immutable view that
+// other threads can read while this one keeps editing.
+template <Fundamental T = char, class Allocator = std::allocator<T>,
+          std::size_t ChunkSize = 64 * 1024>
+class ChunkedGapBuffer {
+    static_assert(ChunkSize >= 4, "chunks must hold a few elements");
+
+public:
+    // STL Compatible Container types
+    using value_type = T;
+    using allocator_type = Allocator;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using reference = value_type&;
+    using const_reference = const value_type&;
+
+    // chunks never keep more than a quarter chunk of gap around
+    using chunk_type =
+        GapBuffer<T, Allocator, GeometricGrowth<2, 1, ChunkSize / 4>>;
+
+    static constexpr size_type chunk_size = ChunkSize;
+
+private:
+    // Either owned, gap-managed storage or a view into the mapped file. Owned
+    // storage may be shared with copies of the buffer and is cloned before
+    // the first write while it is. Element storage comes from the allocator
+    // the chunk is handed.
+    class Chunk {
+        using owned_ptr = std::shared_ptr<chunk_type>;
+
+    public:
+        explicit Chunk(chunk_type owned)
+            : storage(std::make_shared<chunk_type>(std::move(owned))) {
+        }
+
+        explicit Chunk(std::span<const T> view) : storage(view) {
+        }
+
+        template <typename It>
+        Chunk(It first, It last, const allocator_type& alloc)
+            : storage(std::make_shared<chunk_type>(first, last, alloc)) {
+        }
+
+        bool mapped() const {
+            return std::holds_alternative<std::span<const T>>(storage);
+        }
+
+        size_type size() const {
+            if (const auto* view = std::get_if<std::span<const T>>(&storage)) {
+                return view->size();
+            }
+            return std::get<owned_ptr>(storage)->size();
+        }
+
+        const_reference operator[](const size_type pos) const {
+            if (const auto* view = std::get_if<std::span<const T>>(&storage)) {
+                return (*view)[pos];
+            }
+            return std::as_const(*std::get<owned_ptr>(storage))[pos];
+        }
+
+        // Unshared owned storage, copying the mapped view on first use. Only
+        // the owning thread creates copies, so a use count of 1 seen here
+        // cannot grow concurrently.
+        chunk_type& edit(const allocator_type& alloc) {
+            if (const auto* view = std::get_if<std::span<const T>>(&storage)) {
+                storage = std::make_shared<chunk_type>(view->begin(),
+                                                       view->end(), alloc);
+            }
+            owned_ptr& owned = std::get<owned_ptr>(storage);
+            if (owned.use_count() > 1) {
+                owned = std::make_shared<chunk_type>(*owned, alloc);
+            }
+            return *owned;
+        }
+
+        // calls f(first, last) with iterators over the chunk's elements
+        template <typename F>
+        decltype(auto) with_range(F&& f) const {
+            if (const auto* view = std::get_if<std::span<const T>>(&storage)) {
+                return f(view->data(), view->data() + view->size());
+            }
+            const chunk_type& owned = *std::get<owned_ptr>(storage);
+            return f(owned.begin(), owned.end());
+        }
+
+        // trimming either end of a view just narrows it
+        void erase(const size_type pos, const size_type count,
+                   const allocator_type& alloc) {
+            auto* view = std::get_if<std::span<const T>>(&storage);
+            if (view && pos == 0) {
+                *view = view->subspan(count);
+            } else if (view && pos + count == view->size()) {
+                *view = view->first(pos);
+            } else {
+                chunk_type& owned = edit(alloc);
+                owned.erase(owned.begin() + pos, owned.begin() + pos + count);
+            }
+        }
+
+        void append_to(std::string& out) const {
+            with_range([&](auto first, auto last) { out.append(first, last); });
+        }
+
+        void append_iovecs(std::vector<iovec>& iov) const {
+            if (const auto* view = std::get_if<std::span<const T>>(&storage)) {
+                iov.push_back(gb::detail::to_iovec(*view));
+                return;
+            }
+            for (std::span<const T> segment :
+                 std::as_const(*std::get<owned_ptr>(storage)).segments()) {
+                iov.push_back(gb::detail::to_iovec(segment));
+            }
+        }
+
+    private:
+        std::variant<owned_ptr, std::span<const T>> storage;
+    };
+
+    // (chunk, offset) cursor; end() is {chunk count, 0}
+    template <bool Const>
+    class ChunkIterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using buffer_pointer =
+            std::conditional_t<Const, const ChunkedGapBuffer*,
+                               ChunkedGapBuffer*>;
+        using value_type = ChunkedGapBuffer::value_type;
+        using difference_type = std::ptrdiff_t;
+        using reference =
+            std::conditional_t<Const, const value_type&, value_type&>;
+        using pointer =
+            std::conditional_t<Const, const value_type*, value_type*>;
+
+        buffer_pointer cb = nullptr;
+        size_type chunk = 0;
+        size_type offset = 0;
+
+        ChunkIterator() = default;
+        ChunkIterator(buffer_pointer self, size_type chunkIndex,
+                      size_type chunkOffset)
+            : cb(self), chunk(chunkIndex), offset(chunkOffset) {
+        }
+
+        // iterator -> const_iterator
+        template <bool OtherConst>
+            requires(Const && !OtherConst)
+        ChunkIterator(const ChunkIterator<OtherConst>& other)
+            : cb(other.cb), chunk(other.chunk), offset(other.offset) {
+        }
+
+        // logical index of the element
+        difference_type index() const {
+            return static_cast<difference_type>(cb->sizes.prefix(chunk) +
+                                                offset);
+        }
+
+        ChunkIterator& operator++() {
+            if (++offset == cb->chunks[chunk].size()) {
+                ++chunk;
+                offset = 0;
+            }
+            return *this;
+        }
+
+        ChunkIterator operator++(int) {
+            ChunkIterator tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+
+        ChunkIterator& operator--() {
+            if (offset == 0) {
+                --chunk;
+                offset = cb->chunks[chunk].size();
+            }
+            --offset;
+            return *this;
+        }
+
+        ChunkIterator operator--(int) {
+            ChunkIterator tmp = *this;
+            --(*this);
+            return tmp;
+        }
+
+        ChunkIterator operator+(difference_type val) const {
+            const auto [c, o] = cb->locate(index() + val);
+            return ChunkIterator(cb, c, o);
+        }
+
+        ChunkIterator operator-(difference_type val) const {
+            return *this + (-val);
+        }
+
+        difference_type operator-(const ChunkIterator& other) const {
+            return index() - other.index();
+        }
+
+        ChunkIterator& operator+=(difference_type val) {
+            return *this = *this + val;
+        }
+
+        ChunkIterator& operator-=(difference_type val) {
+            return *this = *this - val;
+        }
+
+        reference operator[](difference_type val) const {
+            return *(*this + val);
+        }
+
+        bool operator==(const ChunkIterator& other) const {
+            return chunk == other.chunk && offset == other.offset;
+        }
+
+        auto operator<=>(const ChunkIterator& other) const {
+            if (auto cmp = chunk <=> other.chunk; cmp != 0) {
+                return cmp;
+            }
+            return offset <=> other.offset;
+        }
+
+        reference operator*() const {
+            if constexpr (Const) {
+                return cb->chunks[chunk][offset];
+            } else {
+                return cb->edit_chunk(chunk)[offset];
+            }
+        }
+
+        pointer operator->() const {
+            return &operator*();
+        }
+    };
+
+public:
+    using iterator = ChunkIterator<false>;
+    using const_iterator = ChunkIterator<true>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+    using snapshot_type = std::shared_ptr<const ChunkedGapBuffer>;
+
+    ChunkedGapBuffer() = default;
+
+    explicit ChunkedGapBuffer(
+        const std::type_identity_t<allocator_type>& allocator)
+        : alloc(allocator) {
+    }
+
+    explicit ChunkedGapBuffer(std::string_view str,
+                              const allocator_type& allocator = {})
+        : alloc(allocator) {
+        append_chunks(str.begin(), str.size());
+        rebuild_index();
+    }
+
+    template <typename It>
+    ChunkedGapBuffer(It start, It end, const allocator_type& allocator = {})
+        : alloc(allocator) {
+        append_chunks(start, static_cast<size_type>(std::distance(start, end)));
+        rebuild_index();
+    }
+
+    // Near-instant open of a file of any size: only the chunk index is built,
+    // contents are read from the mapping on demand
+    static ChunkedGapBuffer open_mapped(const std::string& path,
+                                        const allocator_type& allocator = {}) {
+        ChunkedGapBuffer cb(allocator);
+        cb.mapping = std::make_shared<const MappedFile>(path);
+        if (cb.mapping->size() % sizeof(T) != 0) {
+            throw std::runtime_error("open_mapped: " + path +
+                                     " is not a whole number of elements");
+        }
+
+        const std::span<const T> file(
+            reinterpret_cast<const T*>(cb.mapping->data()),
+            cb.mapping->size() / sizeof(T));
+        cb.chunks.reserve((file.size() + ChunkSize - 1) / ChunkSize);
+        for (size_type pos = 0; pos < file.size(); pos += ChunkSize) {
+            cb.chunks.emplace_back(
+                file.subspan(pos, std::min(ChunkSize, file.size() - pos)));
+        }
+        cb.rebuild_index();
+        return cb;
+    }
+
+    reference at(const size_type pos) {
+        if (pos >= size()) {
+            throw std::out_of_range("Out of bounds");
+        }
+        const auto [chunk, offset] = locate(pos);
+        return edit_chunk(chunk)[offset];
+    }
+
+    const_reference at(const size_type pos) const {
+        if (pos >= size()) {
+            throw std::out_of_range("Out of bounds");
+        }
+        const auto [chunk, offset] = locate(pos);
+        return chunks[chunk][offset];
+    }
+
+    allocator_type get_allocator() const noexcept {
+        return alloc;
+    }
+
+    iterator begin() noexcept {
+        return iterator(this, 0, 0);
+    }
+
+    const_iterator begin() const noexcept {
+        return const_iterator(this, 0, 0);
+    }
+
+    const_iterator cbegin() const noexcept {
+        return begin();
+    }
+
+    iterator end() noexcept {
+        return iterator(this, chunks.size(), 0);
+    }
+
+    const_iterator end() const noexcept {
+        return const_iterator(this, chunks.size(), 0);
+    }
+
+    const_iterator cend() const noexcept {
+        return end();
+    }
+
+    reverse_iterator rbegin() noexcept {
+        return reverse_iterator(end());
+    }
+
+    const_reverse_iterator rbegin() const noexcept {
+        return const_reverse_iterator(end());
+    }
+
+    reverse_iterator rend() noexcept {
+        return reverse_iterator(begin());
+    }
+
+    const_reverse_iterator rend() const noexcept {
+        return const_reverse_iterator(begin());
+    }
+
+    size_type size() const {
+        return sizes.total();
+    }
+
+    bool empty() const {
+        return chunks.empty();
+    }
+
+    size_type chunk_count() const {
+        return chunks.size();
+    }
+
+    // Immutable copy of the current contents in O(chunks): chunk storage is
+    // shared, and whichever side writes to a shared chunk first gets its own
+    // copy of just that chunk. Readers on other threads may use the snapshot
+    // (iterate, at, to_string, save, ...) while this buffer is edited;
+    // creating snapshots is reserved to the thread that edits.
+    snapshot_type snapshot() const {
+        return std::make_shared<const ChunkedGapBuffer>(*this);
+    }
+
+    // chunks still served from the file mapping
+    size_type mapped_chunk_count() const {
+        return std::count_if(chunks.begin(), chunks.end(),
+                             [](const Chunk& chunk) { return chunk.mapped(); });
+    }
+
+    void clear() noexcept {
+        chunks.clear();
+        sizes = FenwickTree<size_type>();
+        mapping.reset();
+    }
+
+    std::string to_string() const {
+        std::string ret;
+        ret.reserve(size());
+        for (const Chunk& chunk : chunks) {
+            chunk.append_to(ret);
+        }
+        return ret;
+    }
+
+    // vectored write of every chunk segment, IOV_MAX at a time
+    void write_to(int fd) const {
+        std::vector<iovec> iov;
+        iov.reserve(2 * chunks.size());
+        for (const Chunk& chunk : chunks) {
+            chunk.append_iovecs(iov);
+        }
+        gb::detail::write_all(fd, iov);
+    }
+
+    // Replace the file at path atomically. Safe even when path is the file
+    // this buffer is mapped from: the old inode stays mapped until released.
+    void save(const std::string& path) const {
+        gb::detail::atomic_save(path, [this](int fd) { write_to(fd); });
+    }
+
+    void insert(iterator pos, const T& value) {
+        insert(pos, &value, &value + 1);
+    }
+
+    // Fills the chunk at pos up to ChunkSize; any overflow, together with the
+    // chunk's tail past pos, goes into freshly created chunks
+    template <std::forward_iterator It>
+    void insert(iterator pos, It first, It last) {
+        const size_type count = std::distance(first, last);
+        if (count == 0) {
+            return;
+        }
+        if (chunks.empty()) {
+            append_chunks(first, count);
+            rebuild_index();
+            return;
+        }
+
+        auto [index, offset] = insertion_point(pos.index());
+        chunk_type& chunk = edit_chunk(index);
+        if (chunk.size() + count <= ChunkSize) {
+            chunk.insert(chunk.begin() + offset, first, last);
+            sizes.add(index, count);
+            return;
+        }
+
+        chunk_type tail(chunk.begin() + offset, chunk.end(), alloc);
+        chunk.erase(chunk.begin() + offset, chunk.end());
+
+        const size_type room = std::min(ChunkSize - chunk.size(), count);
+        It split = std::next(first, room);
+        chunk.insert(chunk.end(), first, split);
+
+        std::vector<Chunk> created;
+        for (size_type left = count - room; left > 0;) {
+            const size_type n = std::min(left, ChunkSize);
+            It next = std::next(split, n);
+            created.emplace_back(split, next, alloc);
+            split = next;
+            left -= n;
+        }
+
+        chunk_type& last_chunk =
+            created.empty() ? chunk : created.back().edit(alloc);
+        if (last_chunk.size() + tail.size() <= ChunkSize) {
+            last_chunk.insert(last_chunk.end(), tail.begin(), tail.end());
+        } else {
+            created.emplace_back(std::move(tail));
+        }
+
+        chunks.insert(chunks.begin() + index + 1,
+                      std::make_move_iterator(created.begin()),
+                      std::make_move_iterator(created.end()));
+        rebuild_index();
+    }
+
+    void insert(iterator pos, std::string_view str) {
+        insert(pos, str.begin(), str.end());
+    }
+
+    void erase(iterator pos) {
+        erase(pos, pos + 1);
+    }
+
+    void erase(iterator pos, const size_type count) {
+        erase(pos, pos + count);
+    }
+
+    // Erases chunk by chunk, dropping emptied chunks and merging an
+    // undersized survivor into a neighbour
+    void erase(iterator first, iterator last) {
+        size_type count = last - first;
+        if (count == 0) {
+            return;
+        }
+
+        const size_type firstChunk = first.chunk;
+        size_type index = first.chunk;
+        size_type offset = first.offset;
+        bool structural = false;
+        while (count > 0) {
+            Chunk& chunk = chunks[index];
+            const size_type n = std::min(count, chunk.size() - offset);
+            count -= n;
+            if (n == chunk.size()) {
+                chunks.erase(chunks.begin() + index);
+                structural = true;
+            } else {
+                chunk.erase(offset, n, alloc);
+                if (!structural) {
+                    sizes.add(index, static_cast<size_type>(0) - n);
+                }
+                ++index;
+            }
+            offset = 0;
+        }
+
+        structural |= merge_around(firstChunk);
+        if (structural) {
+            rebuild_index();
+        }
+    }
+
+    void push_back(const T& value) {
+        insert(end(), value);
+    }
+
+private:
+    // chunk index and offset holding logical index pos; pos == size() maps
+    // to end()
+    std::pair<size_type, size_type> locate(const size_type pos) const {
+        return sizes.find(pos);
+    }
+
+    // like locate, but positions on a chunk boundary prefer appending to the
+    // previous chunk while it has room, and end() maps into the last chunk
+    std::pair<size_type, size_type> insertion_point(const size_type pos) const {
+        auto [index, offset] = locate(pos);
+        if (offset == 0 && index > 0 &&
+            (index == chunks.size() || chunks[index - 1].size() < ChunkSize)) {
+            --index;
+            offset = chunks[index].size();
+        }
+        return {index, offset};
+    }
+
+    template <typename It>
+    void append_chunks(It first, size_type count) {
+        while (count > 0) {
+            const size_type n = std::min(count, ChunkSize);
+            It next = std::next(first, n);
+            chunks.emplace_back(first, next, alloc);
+            first = next;
+            count -= n;
+        }
+    }
+
+    // Merge chunk `index` into a neighbour when it dropped below a quarter of
+    // ChunkSize and the two fit in one chunk. Returns whether chunks moved.
+    bool merge_around(size_type index) {
+        if (index >= chunks.size() || chunks[index].size() >= ChunkSize / 4) {
+            return false;
+        }
+        if (index + 1 < chunks.size() &&
+            chunks[index].size() + chunks[index + 1].size() <= ChunkSize) {
+            append_chunk(chunks[index], chunks[index + 1]);
+            chunks.erase(chunks.begin() + index + 1);
+            return true;
+        }
+        if (index > 0 &&
+            chunks[index - 1].size() + chunks[index].size() <= ChunkSize) {
+            append_chunk(chunks[index - 1], chunks[index]);
+            chunks.erase(chunks.begin() + index);
+            return true;
+        }
+        return false;
+    }
+
+    void append_chunk(Chunk& dst, const Chunk& src) {
+        chunk_type& owned = dst.edit(alloc);
+        src.with_range([&](auto first, auto last) {
+            owned.insert(owned.end(), first, last);
+        });
+    }
+
+    chunk_type& edit_chunk(const size_type index) {
+        return chunks[index].edit(alloc);
+    }
+
+    void rebuild_index() {
+        std::vector<size_type> chunkSizes;
+        chunkSizes.reserve(chunks.size());
+        for (const Chunk& chunk : chunks) {
+            chunkSizes.push_back(chunk.size());
+        }
+        sizes.assign(chunkSizes);
+    }
+
+    [[no_unique_address]] allocator_type alloc;
+    std::vector<Chunk> chunks;
+    FenwickTree<size_type> sizes;
+    // keeps the file mapped while any chunk still views it
+    std::shared_ptr<const MappedFile> mapping;
+};
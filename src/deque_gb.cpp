@@ -3,59 +3,113 @@
 #include <string>
 #include <stdexcept>
 
-Gb::Gb(const std::string& string, const size_t& cursor) {
+template <gb::GapStatsPolicy Stats>
+BasicGb<Stats>::BasicGb(const std::string& string, const size_t& cursor) {
 
 }
-void Gb::move_cursor(size_t index) {
+template <gb::GapStatsPolicy Stats>
+void BasicGb<Stats>::move_cursor(size_t index) {
     // if cursor in same position
     if (index == left.size()) {
         return;
     }
+    if (index > size()) {
+        throw std::runtime_error("move cursor: out of range");
+    }
 
+    // one range insert + one range erase instead of a push/pop per char
     if (index < left.size()) {
-        while (left.size() != index) {
-            move_left();
-        }
+        counters.on_gap_move(left.size() - index);
+        const auto first = left.begin() + index;
+        right.insert(right.begin(), first, left.end());
+        left.erase(first, left.end());
     }
 
     else {
-        while (left.size() != index) {
-            move_right();
-        }
+        counters.on_gap_move(index - left.size());
+        const auto last = right.begin() + (index - left.size());
+        left.insert(left.end(), right.begin(), last);
+        right.erase(right.begin(), last);
     }
 }
 
 // (in)(de)crement cursor
-void Gb::move_left() {
+template <gb::GapStatsPolicy Stats>
+void BasicGb<Stats>::move_left() {
     if (left.size() == 0) {
         throw std::runtime_error("move left: out of range");
     }
 
     right.push_front(left.back());
     left.pop_back();
+    counters.on_gap_move(1);
 }
 
-void Gb::move_right() {
+template <gb::GapStatsPolicy Stats>
+void BasicGb<Stats>::move_right() {
     if (right.size() == 0) {
         throw std::runtime_error("move right: out of range");
     }
 
     left.push_back(right.front());
     right.pop_front();
+    counters.on_gap_move(1);
 }
 
-void Gb::insert(const char c) {
+template <gb::GapStatsPolicy Stats>
+void BasicGb<Stats>::insert(const char c) {
     left.push_back(c);
+    counters.on_capacity(size());
 }
 
-void Gb::del() {
-    left.pop_back();
+template <gb::GapStatsPolicy Stats>
+void BasicGb<Stats>::insert(std::string_view str) {
+    left.insert(left.end(), str.begin(), str.end());
+    counters.on_capacity(size());
 }
 
-std::string Gb::string_with_gap() {
-    return std::string(left.begin(), left.end()) + " " + std::string(right.begin(), right.end());
+template <gb::GapStatsPolicy Stats>
+void BasicGb<Stats>::del() {
+    del(1);
 }
 
-std::string Gb::to_string() {
-    return std::string(left.begin(), left.end()) + std::string(right.begin(), right.end());
+template <gb::GapStatsPolicy Stats>
+void BasicGb<Stats>::del(size_t n) {
+    if (n > left.size()) {
+        throw std::runtime_error("del: out of range");
+    }
+
+    left.erase(left.end() - n, left.end());
 }
+
+template <gb::GapStatsPolicy Stats>
+size_t BasicGb<Stats>::size() const {
+    return left.size() + right.size();
+}
+
+template <gb::GapStatsPolicy Stats>
+size_t BasicGb<Stats>::cursor() const {
+    return left.size();
+}
+
+template <gb::GapStatsPolicy Stats>
+std::string BasicGb<Stats>::string_with_gap() const {
+    std::string ret;
+    ret.reserve(size() + 1);
+    ret.append(left.begin(), left.end());
+    ret += ' ';
+    ret.append(right.begin(), right.end());
+    return ret;
+}
+
+template <gb::GapStatsPolicy Stats>
+std::string BasicGb<Stats>::to_string() const {
+    std::string ret;
+    ret.reserve(size());
+    ret.append(left.begin(), left.end());
+    ret.append(right.begin(), right.end());
+    return ret;
+}
+
+template class BasicGb<gb::NoStats>;
+template class BasicGb<gb::GapStats>;
@@ -1,21 +1,46 @@
 #include <deque>
 #include <string>
-class Gb {
+#include <string_view>
+
+#include "gap_stats.h"
+
+// Stats = gb::GapStats counts cursor moves (one "gap move" per splice) and
+// the peak size; the deques' own allocations are not visible to it.
+// Instantiated in deque_gb.cpp for gb::NoStats and gb::GapStats.
+template <gb::GapStatsPolicy Stats = gb::NoStats>
+class BasicGb {
 private:
     std::deque<char> left = {'h', 'e'};
     std::deque<char> right = {'l', 'l', 'o'};
     // cursor = end of left
     // moving cursor through index of full string with no gap (left + right)
     //
+    [[no_unique_address]] Stats counters;
+
 public:
-    Gb(const std::string& string = "", const size_t& cursor = 0);
+    BasicGb(const std::string& string = "", const size_t& cursor = 0);
 
+    // splices the whole block between left and right
     void move_cursor(size_t index);
     void move_left();
     void move_right();
     void insert(const char c);
+    void insert(std::string_view str);
     void del();
+    // backspace n characters
+    void del(size_t n);
 
-    std::string string_with_gap();
-    std::string to_string();
+    size_t size() const;
+    size_t cursor() const;
+
+    std::string string_with_gap() const;
+    std::string to_string() const;
+
+    gb::StatsSnapshot stats() const
+        requires Stats::enabled
+    {
+        return counters.snapshot(0);
+    }
 };
+
+using Gb = BasicGb<>;
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Which parts of a buffer differ from its last saved copy. Two sorted,
+// compact lists, both in current offsets:
+//   written  disjoint [begin, end) ranges holding new content
+//   shifts   (offset, delta) steps of the displacement d(x) between the
+//            current offset x of an unchanged element and its offset in the
+//            saved copy (x - d(x))
+// An element needs writing back when it is new or d(x) != 0. An insert
+// followed by an equal erase nearby cancels out in d, so a same-length
+// replacement only dirties the replaced range.
+class DirtyRanges {
+public:
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+
+    struct Range {
+        size_type offset = 0;
+        size_type length = 0;
+
+        bool operator==(const Range&) const = default;
+    };
+
+    explicit DirtyRanges(const size_type savedSize = 0)
+        : savedSize(savedSize) {
+    }
+
+    size_type saved_size() const noexcept {
+        return savedSize;
+    }
+
+    // the content of `size` elements is now the saved copy
+    void mark_clean(const size_type size) noexcept {
+        written.clear();
+        shifts.clear();
+        savedSize = size;
+    }
+
+    // everything was erased
+    void cleared() noexcept {
+        written.clear();
+        shifts.clear();
+    }
+
+    void inserted(const size_type offset, const size_type count) {
+        if (count == 0) {
+            return;
+        }
+        for (Interval& range : written) {
+            if (range.first >= offset) {
+                range.first += count;
+            }
+            if (range.second > offset) {
+                range.second += count;
+            }
+        }
+        for (auto& [at, delta] : shifts) {
+            if (at >= offset) {
+                at += count;
+            }
+        }
+        add_shift(offset + count, static_cast<difference_type>(count));
+        mark(offset, offset + count);
+    }
+
+    void erased(const size_type offset, const size_type count) {
+        if (count == 0) {
+            return;
+        }
+        const size_type end = offset + count;
+        std::vector<Interval> kept;
+        kept.reserve(written.size() + 1);
+        for (Interval range : written) {
+            const auto move = [&](size_type x) {
+                return x <= offset ? x : (x >= end ? x - count : offset);
+            };
+            range = {move(range.first), move(range.second)};
+            if (range.first < range.second) {
+                kept.push_back(range);
+            }
+        }
+        written = std::move(kept);
+        merge_written();
+
+        // the steps inside the erased range fold into one at offset
+        difference_type folded = -static_cast<difference_type>(count);
+        std::vector<Shift> moved;
+        moved.reserve(shifts.size() + 1);
+        for (const auto& [at, delta] : shifts) {
+            if (at < offset) {
+                moved.push_back({at, delta});
+            } else if (at <= end) {
+                folded += delta;
+            } else {
+                moved.push_back({at - count, delta});
+            }
+        }
+        shifts = std::move(moved);
+        add_shift(offset, folded);
+    }
+
+    // count elements at offset were replaced in place
+    void overwritten(const size_type offset, const size_type count) {
+        if (count > 0) {
+            mark(offset, offset + count);
+        }
+    }
+
+    // Ranges of a content of `size` elements that differ from the saved
+    // copy at the same offset, sorted and merged
+    std::vector<Range> ranges(const size_type size) const {
+        std::vector<Interval> dirty = written;
+        difference_type d = 0;
+        size_type shiftedFrom = 0;
+        for (const auto& [at, delta] : shifts) {
+            const bool wasShifted = d != 0;
+            d += delta;
+            if (!wasShifted && d != 0) {
+                shiftedFrom = at;
+            } else if (wasShifted && d == 0) {
+                dirty.push_back({shiftedFrom, at});
+            }
+        }
+        if (d != 0) {
+            dirty.push_back({shiftedFrom, size});
+        }
+        std::sort(dirty.begin(), dirty.end());
+
+        std::vector<Range> result;
+        size_type end = 0;
+        for (auto [first, last] : dirty) {
+            last = std::min(last, size);
+            if (first >= last) {
+                continue;
+            }
+            if (!result.empty() && first <= end) {
+                end = std::max(end, last);
+                result.back().length = end - result.back().offset;
+            } else {
+                result.push_back({first, last - first});
+                end = last;
+            }
+        }
+        return result;
+    }
+
+    bool clean(const size_type size) const {
+        return size == savedSize && ranges(size).empty();
+    }
+
+private:
+    using Interval = std::pair<size_type, size_type>;
+    using Shift = std::pair<size_type, difference_type>;
+
+    void mark(const size_type first, const size_type last) {
+        const auto pos = std::lower_bound(written.begin(), written.end(),
+                                          Interval{first, last});
+        written.insert(pos, {first, last});
+        merge_written();
+    }
+
+    // sort is kept by every caller; join overlapping and touching ranges
+    void merge_written() {
+        std::size_t out = 0;
+        for (std::size_t i = 0; i < written.size(); ++i) {
+            if (out > 0 && written[i].first <= written[out - 1].second) {
+                written[out - 1].second =
+                    std::max(written[out - 1].second, written[i].second);
+            } else {
+                written[out++] = written[i];
+            }
+        }
+        written.resize(out);
+    }
+
+    void add_shift(const size_type at, const difference_type delta) {
+        auto pos = std::lower_bound(
+            shifts.begin(), shifts.end(), at,
+            [](const Shift& s, size_type offset) { return s.first < offset; });
+        if (pos != shifts.end() && pos->first == at) {
+            pos->second += delta;
+            if (pos->second == 0) {
+                shifts.erase(pos);
+            }
+        } else if (delta != 0) {
+            shifts.insert(pos, {at, delta});
+        }
+    }
+
+    std::vector<Interval> written;
+    std::vector<Shift> shifts;
+    size_type savedSize;
+};
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <span>
+#include <utility>
+#include <vector>
+
+// Undo/redo history of a buffer as a list of replacements (offset, erased
+// elements, inserted elements). The element data of every record lives in
+// one append-only arena, so memory grows with the amount of text edited,
+// not with document size times undo depth.
+//
+// Records between two checkpoints form one undo step. Inserts that continue
+// the previous insert (typing) extend its record instead of adding one.
+template <typename T>
+class EditJournal {
+public:
+    using size_type = std::size_t;
+
+    struct Record {
+        size_type offset;
+        size_type erased;   // erased elements, stored first in the arena
+        size_type inserted; // inserted elements, stored right after
+        size_type data;     // arena index of the erased elements
+        bool groupStart;
+    };
+
+    EditJournal() = default;
+
+    // Take back a history saved through record_list(), arena_data(),
+    // applied_count() and group_closed()
+    EditJournal(std::vector<Record> records, std::vector<T> arena,
+                const size_type applied, const bool groupClosed)
+        : records(std::move(records)), arena(std::move(arena)),
+          applied(applied), groupClosed(groupClosed) {
+    }
+
+    // `erased` (the old contents, possibly split at a gap) is replaced by
+    // `inserted` at offset
+    void record(const size_type offset,
+                const std::array<std::span<const T>, 2>& erased,
+                std::span<const T> inserted) {
+        const size_type erasedCount = erased[0].size() + erased[1].size();
+        if (erasedCount == 0 && inserted.empty()) {
+            return;
+        }
+        discard_redo();
+
+        if (erasedCount == 0 && !groupClosed && !records.empty()) {
+            Record& last = records.back();
+            if (last.erased == 0 && offset == last.offset + last.inserted) {
+                arena.insert(arena.end(), inserted.begin(), inserted.end());
+                last.inserted += inserted.size();
+                return;
+            }
+        }
+
+        records.push_back({offset, erasedCount, inserted.size(), arena.size(),
+                           groupClosed || records.empty()});
+        arena.insert(arena.end(), erased[0].begin(), erased[0].end());
+        arena.insert(arena.end(), erased[1].begin(), erased[1].end());
+        arena.insert(arena.end(), inserted.begin(), inserted.end());
+        groupClosed = false;
+        ++applied;
+    }
+
+    // End the current undo step; the next record starts a new one
+    void checkpoint() noexcept {
+        groupClosed = true;
+    }
+
+    bool can_undo() const noexcept {
+        return applied > 0;
+    }
+
+    bool can_redo() const noexcept {
+        return applied < records.size();
+    }
+
+    // Revert the last undo step through replace(offset, count, elements),
+    // which must erase count elements at offset and insert elements there
+    template <typename Replace>
+    bool undo(Replace&& replace) {
+        if (!can_undo()) {
+            return false;
+        }
+        do {
+            const Record& r = records[--applied];
+            replace(r.offset, r.inserted, erased_of(r));
+        } while (!records[applied].groupStart);
+        groupClosed = true;
+        return true;
+    }
+
+    template <typename Replace>
+    bool redo(Replace&& replace) {
+        if (!can_redo()) {
+            return false;
+        }
+        do {
+            const Record& r = records[applied++];
+            replace(r.offset, r.erased, inserted_of(r));
+        } while (applied < records.size() && !records[applied].groupStart);
+        groupClosed = true;
+        return true;
+    }
+
+    void clear() noexcept {
+        records.clear();
+        arena.clear();
+        applied = 0;
+        groupClosed = true;
+    }
+
+    // elements held for undo and redo
+    size_type arena_size() const noexcept {
+        return arena.size();
+    }
+
+    size_type record_count() const noexcept {
+        return records.size();
+    }
+
+    std::span<const Record> record_list() const noexcept {
+        return records;
+    }
+
+    std::span<const T> arena_data() const noexcept {
+        return arena;
+    }
+
+    size_type applied_count() const noexcept {
+        return applied;
+    }
+
+    bool group_closed() const noexcept {
+        return groupClosed;
+    }
+
+private:
+    std::span<const T> erased_of(const Record& r) const {
+        return std::span<const T>(arena).subspan(r.data, r.erased);
+    }
+
+    std::span<const T> inserted_of(const Record& r) const {
+        return std::span<const T>(arena).subspan(r.data + r.erased,
+                                                 r.inserted);
+    }
+
+    // a new edit after undo forks history: the undone records go away
+    void discard_redo() {
+        if (can_redo()) {
+            arena.resize(records[applied].data);
+            records.resize(applied);
+            groupClosed = true;
+        }
+    }
+
+    std::vector<Record> records;
+    std::vector<T> arena;
+    size_type applied = 0; // records[0, applied) are in effect
+    bool groupClosed = true;
+};
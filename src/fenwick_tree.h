@@ -0,0 +1,80 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Binary indexed tree over a sequence of non-negative counts (chunk sizes,
+// newline counts, ...). Point updates, prefix sums and "which element holds
+// the n-th unit" lookups are all O(log n).
+template <typename V = std::size_t>
+class FenwickTree {
+public:
+    using value_type = V;
+    using size_type = std::size_t;
+
+    FenwickTree() = default;
+
+    // O(n) build from the individual counts
+    template <typename Range>
+    explicit FenwickTree(const Range& values) {
+        assign(values);
+    }
+
+    template <typename Range>
+    void assign(const Range& values) {
+        tree.assign(1, V{});
+        for (const auto& value : values) {
+            tree.push_back(static_cast<V>(value));
+        }
+        for (size_type i = 1; i < tree.size(); ++i) {
+            const size_type parent = i + (i & -i);
+            if (parent < tree.size()) {
+                tree[parent] += tree[i];
+            }
+        }
+    }
+
+    size_type size() const {
+        return tree.empty() ? 0 : tree.size() - 1;
+    }
+
+    // delta may wrap for unsigned V; sums stay correct modulo 2^N
+    void add(size_type index, V delta) {
+        for (size_type i = index + 1; i < tree.size(); i += i & -i) {
+            tree[i] += delta;
+        }
+    }
+
+    // sum of the first count elements
+    V prefix(size_type count) const {
+        V sum{};
+        for (size_type i = count; i > 0; i -= i & -i) {
+            sum += tree[i];
+        }
+        return sum;
+    }
+
+    V total() const {
+        return prefix(size());
+    }
+
+    // Element holding unit `target` (0 based) and the offset of the unit
+    // inside it. Zero sized elements are skipped; target >= total() yields
+    // {size(), target - total()}.
+    std::pair<size_type, V> find(V target) const {
+        size_type pos = 0;
+        for (size_type step = std::bit_floor(size()); step > 0; step >>= 1) {
+            if (pos + step < tree.size() && tree[pos + step] <= target) {
+                pos += step;
+                target -= tree[pos];
+            }
+        }
+        return {pos, target};
+    }
+
+private:
+    // 1 based, tree[0] unused
+    std::vector<V> tree;
+};
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdlib>
+#include <span>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace gb::detail {
+
+[[noreturn]] inline void throw_errno(const std::string& what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+template <typename T>
+iovec to_iovec(std::span<const T> segment) {
+    return {const_cast<T*>(segment.data()), segment.size_bytes()};
+}
+
+// Hand every iovec to write(iovecs, count), which returns the bytes written
+// like writev, resuming after short writes and batching by IOV_MAX. The
+// iovecs are consumed in place.
+template <typename Write>
+void write_iovecs(std::span<iovec> iov, Write&& write, const char* what) {
+    while (!iov.empty()) {
+        if (iov.front().iov_len == 0) {
+            iov = iov.subspan(1);
+            continue;
+        }
+        const int count = static_cast<int>(
+            std::min<std::size_t>(iov.size(), IOV_MAX));
+        const ssize_t written = write(iov.data(), count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw_errno(what);
+        }
+
+        auto left = static_cast<std::size_t>(written);
+        while (!iov.empty() && left >= iov.front().iov_len) {
+            left -= iov.front().iov_len;
+            iov = iov.subspan(1);
+        }
+        if (left > 0) {
+            iov.front().iov_base =
+                static_cast<char*>(iov.front().iov_base) + left;
+            iov.front().iov_len -= left;
+        }
+    }
+}
+
+// writev every iovec to fd
+inline void write_all(int fd, std::span<iovec> iov) {
+    write_iovecs(
+        iov,
+        [fd](const iovec* v, int count) { return ::writev(fd, v, count); },
+        "writev");
+}
+
+// pwritev every iovec to fd starting at offset, leaving the file position
+// alone
+inline void pwrite_all(int fd, std::span<iovec> iov, off_t offset) {
+    write_iovecs(
+        iov,
+        [fd, &offset](const iovec* v, int count) {
+            const ssize_t written = ::pwritev(fd, v, count, offset);
+            if (written > 0) {
+                offset += written;
+            }
+            return written;
+        },
+        "pwritev");
+}
+
+// Write a file atomically: fill a temporary next to path through
+// write(fd), fsync it, then rename it over path. An existing file's
+// permissions are kept.
+template <typename Writer>
+void atomic_save(const std::string& path, Writer&& write) {
+    std::string tmp = path + ".XXXXXX";
+    const int fd = ::mkstemp(tmp.data());
+    if (fd < 0) {
+        throw_errno("mkstemp " + tmp);
+    }
+
+    try {
+        struct stat st {};
+        const mode_t mode = (::stat(path.c_str(), &st) == 0)
+                                ? (st.st_mode & 07777)
+                                : 0644;
+        if (::fchmod(fd, mode) != 0) {
+            throw_errno("fchmod " + tmp);
+        }
+        write(fd);
+        if (::fsync(fd) != 0) {
+            throw_errno("fsync " + tmp);
+        }
+    } catch (...) {
+        ::close(fd);
+        ::unlink(tmp.c_str());
+        throw;
+    }
+
+    if (::close(fd) != 0) {
+        const int err = errno;
+        ::unlink(tmp.c_str());
+        throw std::system_error(err, std::generic_category(), "close " + tmp);
+    }
+    if (::rename(tmp.c_str(), path.c_str()) != 0) {
+        const int err = errno;
+        ::unlink(tmp.c_str());
+        throw std::system_error(err, std::generic_category(),
+                                "rename " + tmp);
+    }
+}
+
+// Rewrite parts of the file at path in place: write(fd) patches it, then it
+// is truncated to newSize bytes and fsynced. Unlike atomic_save a crash can
+// leave the file half updated. Returns false, touching nothing, when the
+// file cannot be opened or is not expectedSize bytes long.
+template <typename Writer>
+bool update_in_place(const std::string& path, const off_t expectedSize,
+                     const off_t newSize, Writer&& write) {
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    try {
+        struct stat st {};
+        if (::fstat(fd, &st) != 0) {
+            throw_errno("fstat " + path);
+        }
+        if (!S_ISREG(st.st_mode) || st.st_size != expectedSize) {
+            ::close(fd);
+            return false;
+        }
+        write(fd);
+        if (newSize != expectedSize && ::ftruncate(fd, newSize) != 0) {
+            throw_errno("ftruncate " + path);
+        }
+        if (::fsync(fd) != 0) {
+            throw_errno("fsync " + path);
+        }
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+
+    if (::close(fd) != 0) {
+        throw_errno("close " + path);
+    }
+    return true;
+}
+
+} // namespace gb::detail
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <ostream>
+
+// Instrumentation policies for the hot paths of GapBuffer and Gb. The
+// buffer calls
+//   on_gap_move(bytes)   after relocating bytes to move the gap
+//   on_reallocate()      when storage is replaced (growth, shrink, batch)
+//   on_capacity(bytes)   whenever storage of that size is acquired
+// NoStats (the default) turns every call into nothing and takes no space;
+// GapStats counts them.
+namespace gb {
+
+template <typename S>
+concept GapStatsPolicy = requires(S stats, std::size_t n) {
+    { S::enabled } -> std::convertible_to<bool>;
+    stats.on_gap_move(n);
+    stats.on_reallocate();
+    stats.on_capacity(n);
+};
+
+struct StatsSnapshot {
+    std::size_t gap_moves = 0;
+    std::size_t bytes_moved = 0;
+    std::size_t reallocations = 0;
+    std::size_t peak_capacity = 0; // bytes
+    std::size_t gap_bytes = 0;     // allocated but unused right now
+    // move_histogram[i] counts gap moves of [2^i, 2^(i+1)) bytes
+    std::array<std::size_t, 64> move_histogram{};
+
+    bool operator==(const StatsSnapshot&) const = default;
+};
+
+inline std::ostream& operator<<(std::ostream& os, const StatsSnapshot& s) {
+    os << "gap moves: " << s.gap_moves << "\nbytes moved: " << s.bytes_moved
+       << "\nreallocations: " << s.reallocations
+       << "\npeak capacity: " << s.peak_capacity
+       << "\ngap bytes: " << s.gap_bytes << "\nmove distances:";
+    for (std::size_t i = 0; i < s.move_histogram.size(); ++i) {
+        if (s.move_histogram[i] > 0) {
+            os << "\n  >= " << (std::size_t{1} << i) << " B: "
+               << s.move_histogram[i];
+        }
+    }
+    return os << '\n';
+}
+
+struct NoStats {
+    static constexpr bool enabled = false;
+
+    void on_gap_move(std::size_t) noexcept {
+    }
+    void on_reallocate() noexcept {
+    }
+    void on_capacity(std::size_t) noexcept {
+    }
+};
+
+class GapStats {
+public:
+    static constexpr bool enabled = true;
+
+    void on_gap_move(const std::size_t bytes) noexcept {
+        ++counts.gap_moves;
+        counts.bytes_moved += bytes;
+        if (bytes > 0) {
+            ++counts.move_histogram[std::bit_width(bytes) - 1];
+        }
+    }
+
+    void on_reallocate() noexcept {
+        ++counts.reallocations;
+    }
+
+    void on_capacity(const std::size_t bytes) noexcept {
+        counts.peak_capacity = std::max(counts.peak_capacity, bytes);
+    }
+
+    // the counters so far; gap_bytes is filled in by the buffer
+    StatsSnapshot snapshot(const std::size_t gapBytes) const noexcept {
+        StatsSnapshot s = counts;
+        s.gap_bytes = gapBytes;
+        return s;
+    }
+
+    void reset() noexcept {
+        counts = {};
+    }
+
+private:
+    StatsSnapshot counts;
+};
+
+} // namespace gb
@@ -2,25 +2,88 @@
 
 #include <algorithm>
 #include <alloca.h>
+#include <array>
+#include <cassert>
+#include <concepts>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <iterator>
 #include <memory>
+#include <memory_resource>
+#include <span>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <tuple>
 #include <type_traits>
 #include <vector>
 
+#include "dirty_ranges.h"
+#include "edit_journal.h"
+#include "file_io.h"
+#include "gap_stats.h"
+#include "growth_policy.h"
+#include "line_index.h"
+#include "mapped_file.h"
+#include "relocate.h"
+#include "segmented.h"
+#include "session.h"
+#include "simd_search.h"
+#include "utf8.h"
+#include "utf8_index.h"
+
 template <typename T>
 concept Fundamental = std::is_fundamental_v<T>;
 
-template <Fundamental T = char, class Allocator = std::allocator<T>>
+// Anything a GapBuffer can hold. The gap is raw storage and gap moves must
+// not fail halfway, so elements need a non-throwing move (or must be
+// trivially relocatable).
+template <typename T>
+concept GapElement =
+    std::is_object_v<T> && !std::is_const_v<T> &&
+    std::is_nothrow_destructible_v<T> &&
+    (std::is_nothrow_move_constructible_v<T> ||
+     gb::is_trivially_relocatable_v<T>);
+
+namespace gb::detail {
+// Raw in-object storage for N elements; takes no space when N is 0
+template <typename T, std::size_t N>
+struct InlineStorage {
+    T* data() noexcept {
+        return reinterpret_cast<T*>(bytes);
+    }
+    const T* data() const noexcept {
+        return reinterpret_cast<const T*>(bytes);
+    }
+
+    alignas(T) std::byte bytes[N * sizeof(T)];
+};
+
+template <typename T>
+struct InlineStorage<T, 0> {
+    T* data() const noexcept {
+        return nullptr;
+    }
+};
+} // namespace gb::detail
+
+// InlineCapacity > 0 keeps buffers of up to that many elements (content and
+// gap) inside the object; only growing past it touches the allocator.
+// Stats = gb::GapStats counts gap moves and reallocations (see stats()).
+template <GapElement T = char, class Allocator = std::allocator<T>,
+          GapGrowthPolicy GrowthPolicy = GeometricGrowth<>,
+          std::size_t InlineCapacity = 0,
+          gb::GapStatsPolicy Stats = gb::NoStats>
 class GapBuffer {
 public:
     // STL Compatible Container types
     using value_type = T;
     using allocator_type = Allocator;
+    using growth_policy = GrowthPolicy;
+    static constexpr std::size_t inline_capacity = InlineCapacity;
+    using stats_policy = Stats;
     using size_type = std::size_t;
     using difference_type = std::ptrdiff_t;
     using reference = value_type&;
@@ -28,8 +91,22 @@ public:
     using pointer = std::allocator_traits<Allocator>::pointer;
     using const_pointer = std::allocator_traits<Allocator>::const_pointer;
 
+    static constexpr size_type npos = static_cast<size_type>(-1);
+
+    // Replace `erase` elements at offset with `insert`. Offsets refer to the
+    // content before any edit of the batch is applied.
+    struct Edit {
+        size_type offset = 0;
+        size_type erase = 0;
+        std::span<const T> insert;
+    };
+
 private:
-    // Iterator to abstract the gap
+    using alloc_traits = std::allocator_traits<Allocator>;
+
+    // Iterator to abstract the gap. Random access but not contiguous: the
+    // content is two runs, which segments() hands to the gb:: algorithms
+    // (segmented.h) so they can loop over plain pointers.
     template <typename PointerType>
     class GapIterator {
     public:
@@ -38,18 +115,16 @@ private:
         // compatibilty
         static const bool is_const =
             std::is_const_v<std::remove_pointer_t<PointerType>>;
-        using iterator_category = std::contiguous_iterator_tag;
+        using iterator_category = std::random_access_iterator_tag;
         using gapbuffer_pointer =
             std::conditional<is_const, const GapBuffer*, GapBuffer*>::type;
 
-        using value_type =
-            std::conditional<is_const, const GapBuffer::value_type,
-                             GapBuffer::value_type>::type;
+        using value_type = GapBuffer::value_type;
         using element_type =
             std::conditional<is_const, const value_type, value_type>::type;
 
         using pointer = PointerType;
-        using reference = value_type&;
+        using reference = element_type&;
         using difference_type =
             std::ptrdiff_t; // difference type of 2 iterators
         // difference between INDEXES NOT values
@@ -59,8 +134,31 @@ private:
 
         explicit GapIterator() = default;
         // self = GapBuffer that will be iterated
+        // a pointer at gapStart names the same element as gapEnd, so it is
+        // normalized to gapEnd and never dereferences into the gap
         explicit GapIterator(gapbuffer_pointer self, PointerType input_ptr)
             : gb(self), ptr(input_ptr) {
+            if (ptr == gb->gapStart) {
+                ptr = gb->gapEnd;
+            }
+        }
+
+        // [*this, last) as at most two contiguous runs, split at the gap
+        std::array<std::span<element_type>, 2>
+        segments(const GapIterator& last) const noexcept {
+            if (ptr < gb->gapStart && last.ptr >= gb->gapEnd) {
+                return {std::span<element_type>(ptr, gb->gapStart),
+                        std::span<element_type>(gb->gapEnd, last.ptr)};
+            }
+            return {std::span<element_type>(ptr, last.ptr),
+                    std::span<element_type>()};
+        }
+
+        // logical index of the element (gap excluded)
+        difference_type index() const {
+            const difference_type offset = ptr - gb->bufferStart;
+            return (ptr >= gb->gapEnd) ? offset - (gb->gapEnd - gb->gapStart)
+                                       : offset;
         }
 
         GapIterator& operator++() {
@@ -74,72 +172,70 @@ private:
         GapIterator operator++(int) {
             GapIterator tmp = *this;
             ++(*this);
-            if (ptr == gb->gapStart) {
-                ptr = gb->gapEnd;
-            }
-            return *this;
+            return tmp;
         }
 
         GapIterator& operator--() {
-            ptr -= 1;
             if (ptr == gb->gapEnd) {
-                ptr = gb->gapStart - 1;
+                ptr = gb->gapStart;
             }
+            ptr -= 1;
             return *this;
         }
 
         GapIterator operator--(int) {
             GapIterator tmp = *this;
             --(*this);
-            if (ptr == gb->gapEnd) {
-                ptr = gb->gapStart - 1;
-            }
             return tmp;
         }
 
         GapIterator operator+(difference_type val) const {
-            pointer newPtr = ptr + val;
-            if (ptr <= gb->gapStart && newPtr > gb->gapStart) {
-                newPtr += gb->gapEnd - gb->gapStart; // Skip the gap
+            const difference_type target = index() + val;
+            const difference_type gapIndex = gb->gapStart - gb->bufferStart;
+            if (target < gapIndex) {
+                return GapIterator(gb, gb->bufferStart + target);
             }
-            return GapIterator(gb, newPtr);
+            return GapIterator(gb, gb->gapEnd + (target - gapIndex));
+        }
+
+        friend GapIterator operator+(difference_type val,
+                                     const GapIterator& it) {
+            return it + val;
         }
 
         GapIterator operator-(difference_type val) const {
-            pointer newPtr = ptr - val;
-            if (ptr >= gb->gapEnd && newPtr < gb->gapEnd) {
-                newPtr -= gb->gapEnd - gb->gapStart; // Skip the gap
-            }
-            return GapIterator(gb, newPtr);
+            return *this + (-val);
         }
 
         difference_type operator-(const GapIterator& other) const {
-            if (ptr <= gb->gapStart && other.ptr <= gb->gapStart) {
-                return ptr - other.ptr;
-            }
-            if (ptr >= gb->gapEnd && other.ptr >= gb->gapEnd) {
-                return ptr - other.ptr;
-            }
-            return (ptr < gb->gapStart)
-                       ? (ptr - other.ptr) - (gb->gapEnd - gb->gapStart)
-                       : (ptr - gb->gapEnd) + (gb->gapStart - other.ptr);
+            return index() - other.index();
         }
 
         GapIterator& operator+=(difference_type val) {
-            ptr += val;
-            return *this;
+            return *this = *this + val;
         }
 
         GapIterator& operator-=(difference_type val) {
-            ptr -= val;
-            return *this;
+            return *this = *this - val;
+        }
+
+        reference operator[](difference_type val) const {
+            return *(*this + val);
+        }
+
+        bool operator==(const GapIterator& other) const {
+            return ptr == other.ptr;
         }
 
-        reference operator*() {
+        auto operator<=>(const GapIterator& other) const {
+            return ptr <=> other.ptr;
+        }
+
+        reference operator*() const {
             return *ptr;
         }
         PointerType operator->() const {
-            return &operator*();
+            return ptr;
         }
     };
 
@@ -151,73 +247,77 @@ private:
 
 public:
     // https://en.cppreference.com/w/cpp/memory/uninitialized_copy_n
-    // allocated memory is uninitialized, cannot use std::copy yet
-    constexpr explicit GapBuffer() {
-        bufferStart = allocator_type().allocate(32);
-        bufferEnd = std::uninitialized_value_construct_n(bufferStart, 32);
-        gapStart = bufferStart;
-        gapEnd = bufferEnd;
+    // allocated memory is uninitialized, cannot use std::copy yet. Only the
+    // content is ever constructed; the gap stays raw storage.
+    constexpr GapBuffer() : GapBuffer(allocator_type()) {
     }
 
-    constexpr explicit GapBuffer(const size_type& size) {
-        bufferStart = allocator_type().allocate(size);
-        bufferEnd = std::uninitialized_value_construct_n(bufferStart, size);
+    // type_identity keeps GapBuffer(64) from deducing the allocator
+    constexpr explicit GapBuffer(
+        const std::type_identity_t<allocator_type>& allocator)
+        : GapBuffer(InlineCapacity > 0 ? InlineCapacity
+                                       : GrowthPolicy::default_capacity,
+                    allocator) {
+    }
+
+    constexpr explicit GapBuffer(const size_type& size,
+                                 const allocator_type& allocator = {})
+        : alloc(allocator) {
+        size_type capacity = size;
+        bufferStart = acquire(capacity);
+        bufferEnd = bufferStart + capacity; // all gap
         gapStart = bufferStart;
         gapEnd = bufferEnd;
     }
 
-    constexpr explicit GapBuffer(std::string_view str) {
-        bufferStart = allocator_type().allocate(str.size() + 8);
-        std::uninitialized_copy_n(str.begin(), str.size(), bufferStart);
-
-        gapStart = bufferStart + str.size();
-        gapEnd = gapStart + 8;
-        bufferEnd = gapEnd;
+    constexpr explicit GapBuffer(std::string_view str,
+                                 const allocator_type& allocator = {})
+        : GapBuffer(str.begin(), str.end(), allocator) {
     }
 
     template <typename It>
-    constexpr explicit GapBuffer(It start, It end) {
+    constexpr explicit GapBuffer(It start, It end,
+                                 const allocator_type& allocator = {})
+        : alloc(allocator) {
         const size_type len = std::distance(start, end);
+        size_type capacity = len + GrowthPolicy::initial_gap(len);
 
-        bufferStart =
-            allocator_type().allocate(len + 8); // range + gap (length 8)
+        bufferStart = acquire(capacity); // range + gap
         std::uninitialized_copy_n(start, len, bufferStart);
 
         gapStart = bufferStart + len;
-        gapEnd = gapStart + 8;
-        bufferEnd = gapEnd;
+        bufferEnd = bufferStart + capacity;
+        gapEnd = bufferEnd;
     }
 
     // Copy Constructor
     // new instance = copy of other instance
-    constexpr GapBuffer(const GapBuffer& other) {
-        bufferStart = allocator_type().allocate(other.capacity());
-        std::uninitialized_copy_n(other.bufferStart, other.capacity(),
-                                  bufferStart);
+    constexpr GapBuffer(const GapBuffer& other)
+        : GapBuffer(other,
+                    alloc_traits::select_on_container_copy_construction(
+                        other.alloc)) {
+    }
 
-        gapStart =
-            bufferStart +
-            (other.gapStart - other.bufferStart); // subtracting bufferStart
-                                                  // necessary for the offset
-        gapEnd = bufferStart + (other.gapEnd - other.bufferStart); // same here
-        bufferEnd = bufferStart + other.capacity();
+    // copy into memory from allocator
+    constexpr GapBuffer(const GapBuffer& other, const allocator_type& allocator)
+        : alloc(allocator) {
+        copy_storage(other);
+        copy_extras(other);
     }
 
     // Copy Assignment
     // initialized instance = copy of other instance
     constexpr GapBuffer& operator=(const GapBuffer& other) {
         if (this != &other) {
-            pointer newBuffStart = allocator_type().allocate(other.capacity());
-            std::uninitialized_copy_n(other.bufferStart, other.capacity(),
-                                      newBuffStart);
-
-            std::destroy_n(bufferStart, capacity());
-            allocator_type().deallocate(bufferStart, capacity());
-
-            bufferStart = newBuffStart;
-            gapStart = newBuffStart + (other.gapStart - other.bufferStart);
-            gapEnd = newBuffStart + (other.gapEnd - other.bufferStart);
-            bufferEnd = newBuffStart + other.capacity();
+            using propagate =
+                alloc_traits::propagate_on_container_copy_assignment;
+            // copy first so that a throwing copy leaves *this untouched
+            GapBuffer copy(other, propagate::value ? other.alloc : alloc);
+            release();
+            if constexpr (propagate::value) {
+                alloc = other.alloc;
+            }
+            steal(copy);
         }
 
         return *this;
@@ -226,44 +326,94 @@ public:
     // Move Constructor
     // new instance = std::move(other instance)
     constexpr GapBuffer(GapBuffer&& other) noexcept
-        : bufferStart(other.bufferStart), gapStart(other.gapStart),
-          gapEnd(other.gapEnd), bufferEnd(other.bufferEnd) {
-        other.bufferStart = nullptr;
-        other.gapStart = nullptr;
-        other.gapEnd = nullptr;
-        other.bufferEnd = nullptr;
+        : alloc(std::move(other.alloc)) {
+        steal(other);
+    }
+
+    // storage is only taken over when allocator can free it
+    constexpr GapBuffer(GapBuffer&& other, const allocator_type& allocator)
+        : alloc(allocator) {
+        if (alloc == other.alloc) {
+            steal(other);
+        } else {
+            copy_storage(other);
+            copy_extras(other);
+        }
     }
 
     // Move Assignment
     // initialized instance = std::move(other instance)
-    constexpr GapBuffer& operator=(GapBuffer&& other) noexcept {
-        if (this != &other) {
-            std::destroy_n(bufferStart, capacity());
-            allocator_type().deallocate(bufferStart, capacity());
-
-            bufferStart = other.bufferStart;
-            gapStart = other.gapStart;
-            gapEnd = other.gapEnd;
-            bufferEnd = other.bufferEnd;
-
-            other.bufferStart = nullptr;
-            other.gapStart = nullptr;
-            other.gapEnd = nullptr;
-            other.bufferEnd = nullptr;
+    constexpr GapBuffer& operator=(GapBuffer&& other) noexcept(
+        alloc_traits::propagate_on_container_move_assignment::value ||
+        alloc_traits::is_always_equal::value) {
+        if (this == &other) {
+            return *this;
+        }
+        using propagate = alloc_traits::propagate_on_container_move_assignment;
+        if constexpr (propagate::value) {
+            release();
+            alloc = std::move(other.alloc);
+            steal(other);
+        } else if (alloc == other.alloc) {
+            release();
+            steal(other);
+        } else {
+            // other's memory belongs to an allocator we cannot free with
+            *this = static_cast<const GapBuffer&>(other);
         }
 
         return *this;
     }
+
     ~GapBuffer() {
+#ifdef GAPBUFFER_DEBUG
+        // addresses, not contents: a char pointer would print as a C string
         std::cout << "Destructor called\n";
-        std::cout << "bufferStart: " << bufferStart << "\n";
-        std::cout << "gapStart: " << gapStart << "\n";
-        std::cout << "gapEnd: " << gapEnd << "\n";
-        std::cout << "bufferEnd: " << bufferEnd << "\n";
-        if (bufferStart) {
-            delete[] bufferStart;
+        std::cout << "bufferStart: " << static_cast<const void*>(bufferStart)
+                  << "\n";
+        std::cout << "gapStart: " << static_cast<const void*>(gapStart)
+                  << "\n";
+        std::cout << "gapEnd: " << static_cast<const void*>(gapEnd) << "\n";
+        std::cout << "bufferEnd: " << static_cast<const void*>(bufferEnd)
+                  << "\n";
+#endif
+        release();
+    }
+
+    allocator_type get_allocator() const noexcept {
+        return alloc;
+    }
+
+    void swap(GapBuffer& other) noexcept {
+        using std::swap;
+        if constexpr (alloc_traits::propagate_on_container_swap::value) {
+            swap(alloc, other.alloc);
+        } else {
+            // heap storage only changes hands between equal allocators
+            assert(alloc == other.alloc || (is_inline() && other.is_inline()));
         }
-        bufferStart = gapStart = gapEnd = bufferEnd = nullptr;
+        if (is_inline() || other.is_inline()) {
+            // inline content is relocated with nothrow moves; going through
+            // move assignment could copy, and allocate, for a stateful
+            // allocator that does not propagate
+            // (copying the allocator leaves other's as it is)
+            GapBuffer tmp(std::move(other), other.alloc);
+            other.steal(*this);
+            steal(tmp);
+            return;
+        }
+        swap(bufferStart, other.bufferStart);
+        swap(gapStart, other.gapStart);
+        swap(gapEnd, other.gapEnd);
+        swap(bufferEnd, other.bufferEnd);
+        swap(lineIndex, other.lineIndex);
+        swap(utf8Index, other.utf8Index);
+        swap(journal, other.journal);
+        swap(dirty, other.dirty);
+    }
+
+    friend void swap(GapBuffer& a, GapBuffer& b) noexcept {
+        a.swap(b);
     }
 
     constexpr reference at(const size_type pos) {
@@ -274,14 +424,11 @@ public:
             static_cast<size_type>(gapStart - bufferStart);
         if (pos < gapStartIndex) {
             return *(bufferStart + pos);
-        } else if (pos > *gapStart) {
-            return *(gapEnd + (pos - (gapStart - bufferStart)));
-        } else {
-            throw std::out_of_range("Pos cannot be in gap");
         }
+        return *(gapEnd + (pos - gapStartIndex));
     }
 
-    constexpr reference at(const size_type pos) const {
+    constexpr const_reference at(const size_type pos) const {
         if (pos >= size()) {
             throw std::out_of_range("Out of bounds");
         }
@@ -289,11 +436,18 @@ public:
             static_cast<size_type>(gapStart - bufferStart);
         if (pos < gapStartIndex) {
             return *(bufferStart + pos);
-        } else if (pos > *gapStart) {
-            return *(gapEnd + (pos - (gapStart - bufferStart)));
-        } else {
-            throw std::out_of_range("Pos cannot be in gap");
         }
+        return *(gapEnd + (pos - gapStartIndex));
+    }
+
+    // unchecked access
+    constexpr reference operator[](const size_type pos) {
+        return *pointer_at(pos);
+    }
+
+    constexpr const_reference operator[](const size_type pos) const {
+        return (pos < gap_index()) ? *(bufferStart + pos)
+                                   : *(gapEnd + (pos - gap_index()));
     }
 
     iterator begin() noexcept {
@@ -322,23 +476,19 @@ public:
 
     // reverse iterators
     reverse_iterator rbegin() noexcept {
-        return reverse_iterator(
-            iterator(this, (gapEnd == bufferEnd) ? gapStart : bufferEnd));
+        return reverse_iterator(end());
     }
 
     const_reverse_iterator rbegin() const noexcept {
-        return const_reverse_iterator(
-            iterator(this, (gapEnd == bufferEnd) ? gapStart : bufferEnd));
+        return const_reverse_iterator(end());
     }
 
     reverse_iterator rend() noexcept {
-        return reverse_iterator(
-            iterator(this, (gapStart == bufferStart) ? gapEnd : bufferStart));
+        return reverse_iterator(begin());
     }
 
     const_reverse_iterator rend() const noexcept {
-        return const_reverse_iterator(const_iterator(
-            this, (gapStart == bufferStart) ? gapEnd : bufferStart));
+        return const_reverse_iterator(begin());
     }
 
     // size ignoring the gap
@@ -367,43 +517,41 @@ public:
     }
 
     constexpr void clear() noexcept {
-        std::destroy_n(bufferStart, capacity());
+        destroy_content();
         gapStart = bufferStart;
         gapEnd = bufferEnd;
+        if (lineIndex) {
+            lineIndex->clear();
+        }
+        if (utf8Index) {
+            utf8Index->clear();
+        }
+        if (journal) {
+            journal->clear(); // clearing is not undoable
+        }
+        if (dirty) {
+            dirty->cleared();
+        }
     }
 
-    // TODO problem with resizing when cursor is at very end
     void resize(const size_type newCapacity) {
         if (newCapacity <= capacity()) {
             return; // No resizing needed
         }
 
-        // Allocate new buffer
-        pointer newBuffer = allocator_type().allocate(newCapacity);
-        assert(newBuffer != nullptr);
-
-        size_type prefixSize = gapStart - bufferStart;
-        size_type suffixSize = bufferEnd - gapEnd;
-
-        // Copy elements before and after the gap
-        std::uninitialized_copy_n(bufferStart, prefixSize, newBuffer);
-        std::uninitialized_copy_n(gapEnd, suffixSize,
-                                  newBuffer + newCapacity - suffixSize);
-
-        // Destroy and deallocate old buffer
-        std::destroy_n(bufferStart, capacity());
-        allocator_type().deallocate(bufferStart, capacity());
+        reallocate(newCapacity);
+    }
 
-        // Update buffer pointers
-        bufferStart = newBuffer;
-        gapStart = bufferStart + prefixSize;
-        gapEnd = bufferStart + newCapacity - suffixSize;
-        bufferEnd = bufferStart + newCapacity;
+    // Give back the memory the growth policy considers excess
+    void shrink_to_fit() {
+        const size_type newCapacity =
+            GrowthPolicy::shrink(size(), capacity());
+        if (newCapacity < capacity()) {
+            reallocate(std::max(newCapacity, size()));
+        }
+    }
 
-        assert(bufferStart != nullptr);
-        assert(bufferEnd == bufferStart + newCapacity);
-        assert(gapStart <= gapEnd);
-    } // cannot be string_view because sv locally dangles
+    // cannot be string_view because sv locally dangles
     constexpr std::string to_string() const {
         std::string ret;
         ret.reserve(size()); // reserve size of buffer w/o gap for performance
@@ -412,41 +560,954 @@ public:
         return ret;
     }
 
-    constexpr void insert(iterator pos, const char c) {
-        if (gapSize() == 0) {
-            int posLen = pos - begin();
-            resize(capacity() * 2);
-            pos = begin() + posLen; // Adjust pos without adding unnecessary +1
+    // the content as [bufferStart, gapStart) and [gapEnd, bufferEnd)
+    constexpr std::array<std::span<T>, 2> segments() noexcept {
+        return {std::span<T>(bufferStart, gapStart),
+                std::span<T>(gapEnd, bufferEnd)};
+    }
+
+    constexpr std::array<std::span<const T>, 2> segments() const noexcept {
+        return {std::span<const T>(bufferStart, gapStart),
+                std::span<const T>(gapEnd, bufferEnd)};
+    }
+
+    // Write the content to fd with a single writev over both segments (more
+    // only after a short write), without building an intermediate copy
+    void write_to(int fd) const {
+        const auto [prefix, suffix] = segments();
+        std::array<iovec, 2> iov = {gb::detail::to_iovec(prefix),
+                                    gb::detail::to_iovec(suffix)};
+        gb::detail::write_all(fd, iov);
+    }
+
+    // Replace the file at path atomically (temporary file, fsync, rename)
+    void save(const std::string& path) const {
+        gb::detail::atomic_save(path, [this](int fd) { write_to(fd); });
+    }
+
+    // Opt-in tracking of which ranges differ from the last saved copy, kept
+    // by insert/erase/push_back/apply_batch/overwrite/undo/redo. Writes
+    // through operator[], at() or iterators are not seen: change elements
+    // in place with overwrite() instead.
+    void enable_dirty_tracking() {
+        dirty = std::make_unique<DirtyRanges>(size());
+    }
+
+    void disable_dirty_tracking() noexcept {
+        dirty.reset();
+    }
+
+    bool has_dirty_tracking() const noexcept {
+        return dirty != nullptr;
+    }
+
+    // what differs from the last saved copy; all of it without tracking
+    std::vector<DirtyRanges::Range> dirty_ranges() const {
+        if (!dirty) {
+            return size() > 0 ? std::vector<DirtyRanges::Range>{{0, size()}}
+                              : std::vector<DirtyRanges::Range>{};
+        }
+        return dirty->ranges(size());
+    }
+
+    // the current content is what the last saved copy holds
+    void mark_clean() noexcept {
+        if (dirty) {
+            dirty->mark_clean(size());
+        }
+    }
+
+    // Bring the file at path, last written by save() or save_incremental()
+    // of this buffer, up to date and return the bytes written. When the
+    // length is unchanged only the dirty ranges are pwritten; otherwise
+    // everything from the first dirty offset on is, and the file is
+    // truncated. Without tracking, or when the file is not the length last
+    // saved, this is a full atomic save() that starts tracking. The update
+    // itself is in place, so unlike save() it is not crash safe.
+    size_type save_incremental(const std::string& path) {
+        if (dirty) {
+            std::vector<DirtyRanges::Range> ranges = dirty->ranges(size());
+            const size_type saved = dirty->saved_size();
+            if (ranges.empty() && saved == size()) {
+                return 0;
+            }
+            if (saved != size()) { // stream the tail
+                const size_type from =
+                    ranges.empty() ? size() : ranges.front().offset;
+                ranges = {{from, size() - from}};
+            }
+
+            size_type written = 0;
+            const auto patch = [&](const int fd) {
+                for (const DirtyRanges::Range& range : ranges) {
+                    const auto [prefix, suffix] =
+                        range_segments(range.offset, range.length);
+                    std::array<iovec, 2> iov = {gb::detail::to_iovec(prefix),
+                                                gb::detail::to_iovec(suffix)};
+                    gb::detail::pwrite_all(
+                        fd, iov, static_cast<off_t>(range.offset * sizeof(T)));
+                    written += range.length * sizeof(T);
+                }
+            };
+            if (gb::detail::update_in_place(
+                    path, static_cast<off_t>(saved * sizeof(T)),
+                    static_cast<off_t>(size() * sizeof(T)), patch)) {
+                dirty->mark_clean(size());
+                return written;
+            }
+        }
+        save(path);
+        if (dirty) {
+            dirty->mark_clean(size());
+        } else {
+            dirty = std::make_unique<DirtyRanges>(size());
+        }
+        return size() * sizeof(T);
+    }
+
+    // Save a session (see session.h): the content with the gap where it
+    // is, the line index and the undo journal when they are enabled, all
+    // atomically like save(). Dirty tracking is not part of it.
+    void save_session(const std::string& path) const
+        requires std::is_trivially_copyable_v<T>
+    {
+        namespace session = gb::session;
+        const auto [prefix, suffix] = segments();
+        session::Sections sections{};
+        session::Header& header = sections.header;
+        header.element_size = sizeof(T);
+        header.prefix = prefix.size();
+        header.suffix = suffix.size();
+        header.capacity = capacity();
+        sections.prefix = std::as_bytes(prefix);
+        sections.suffix = std::as_bytes(suffix);
+
+        std::vector<std::uint64_t> lines;
+        if (lineIndex) {
+            header.flags |= session::has_line_index;
+            for (const LineIndex::Block& block : lineIndex->block_list()) {
+                lines.insert(lines.end(), {block.bytes, block.units});
+            }
+            header.line_blocks = lines.size() / session::line_block_words;
+        }
+        if (utf8Index) {
+            header.flags |= session::has_utf8_index;
+        }
+        std::vector<std::uint64_t> records;
+        std::span<const T> arena;
+        if (journal) {
+            header.flags |= session::has_journal;
+            if (journal->group_closed()) {
+                header.flags |= session::journal_group_closed;
+            }
+            for (const auto& r : journal->record_list()) {
+                records.insert(records.end(), {r.offset, r.erased, r.inserted,
+                                               r.data, r.groupStart});
+            }
+            arena = journal->arena_data();
+            header.journal_records = records.size() / session::record_words;
+            header.journal_arena = arena.size();
+            header.journal_applied = journal->applied_count();
+        }
+        sections.line_blocks = std::as_bytes(std::span(lines));
+        sections.journal_records = std::as_bytes(std::span(records));
+        sections.journal_arena = std::as_bytes(arena);
+        header.checksum = session::checksum(sections);
+
+        static constexpr std::array<std::byte, 8> zeros{};
+        const auto padding = [](const std::size_t bytes) {
+            return std::span(zeros).first(session::align8(bytes) - bytes);
+        };
+        const std::span<const session::Header> head(&header, 1);
+        const std::size_t content = sections.prefix.size_bytes() +
+                                    sections.suffix.size_bytes();
+        std::array<iovec, 8> iov = {
+            gb::detail::to_iovec(head),
+            gb::detail::to_iovec(sections.prefix),
+            gb::detail::to_iovec(sections.suffix),
+            gb::detail::to_iovec(padding(content)),
+            gb::detail::to_iovec(sections.line_blocks),
+            gb::detail::to_iovec(sections.journal_records),
+            gb::detail::to_iovec(sections.journal_arena),
+            gb::detail::to_iovec(padding(arena.size_bytes()))};
+        gb::detail::atomic_save(
+            path, [&iov](int fd) { gb::detail::write_all(fd, iov); });
+    }
+
+    // Pick up a session written by save_session. The file is mapped and its
+    // sections are copied in bulk straight to where they belong: the content
+    // on both sides of the gap, the index blocks and the journal. Nothing is
+    // re-read to rebuild them, and the gap is restored as saved unless it
+    // is far beyond anything the growth policy keeps. Throws
+    // std::runtime_error for a file that does not check out.
+    static GapBuffer load_session(const std::string& path,
+                                  const allocator_type& allocator = {})
+        requires std::is_trivially_copyable_v<T> &&
+                 std::default_initializable<T>
+    {
+        namespace session = gb::session;
+        const MappedFile file(path);
+        const session::Sections sections =
+            session::parse({file.data(), file.size()}, sizeof(T));
+        const session::Header& header = sections.header;
+        const auto copy = [](void* to, std::span<const std::byte> from) {
+            if (!from.empty()) {
+                std::memcpy(to, from.data(), from.size());
+            }
+        };
+        const auto word = [](std::span<const std::byte> words,
+                             const std::size_t i) {
+            std::uint64_t value;
+            std::memcpy(&value, words.data() + i * sizeof(value),
+                        sizeof(value));
+            return static_cast<size_type>(value);
+        };
+
+        // the checksum vouches for the bytes, not for what they say: check
+        // what the index and the journal will rely on before building them
+        const size_type content = header.prefix + header.suffix;
+        std::vector<LineIndex::Block> blocks(header.line_blocks);
+        size_type indexed = 0;
+        for (std::size_t i = 0; i < blocks.size(); ++i) {
+            blocks[i] = {word(sections.line_blocks, 2 * i),
+                         word(sections.line_blocks, 2 * i + 1)};
+            if (blocks[i].bytes > content - indexed) {
+                break;
+            }
+            indexed += blocks[i].bytes;
+        }
+        if ((header.flags & session::has_line_index) && indexed != content) {
+            throw std::runtime_error(
+                "session: line index does not cover the content");
+        }
+        using Record = typename EditJournal<T>::Record;
+        std::vector<Record> records(header.journal_records);
+        for (std::size_t i = 0; i < records.size(); ++i) {
+            const std::size_t at = i * session::record_words;
+            records[i] = {word(sections.journal_records, at),
+                          word(sections.journal_records, at + 1),
+                          word(sections.journal_records, at + 2),
+                          word(sections.journal_records, at + 3),
+                          word(sections.journal_records, at + 4) != 0};
+            const Record& r = records[i];
+            const size_type arena = header.journal_arena;
+            if (r.data > arena || r.erased > arena - r.data ||
+                r.inserted > arena - r.data - r.erased) {
+                throw std::runtime_error(
+                    "session: journal record outside the arena");
+            }
+        }
+        // undo replays records[applied - 1] down to records[0], redo the
+        // rest upwards: each has to fit the length the content will have
+        const auto outside = [](const Record& r, const size_type length,
+                                const size_type replaced) {
+            return r.offset > length || replaced > length - r.offset;
+        };
+        if (!records.empty() && !records.front().groupStart) {
+            throw std::runtime_error("session: journal starts mid-step");
+        }
+        size_type length = content;
+        for (size_type i = header.journal_applied; i-- > 0;) {
+            const Record& r = records[i];
+            if (outside(r, length, r.inserted)) {
+                throw std::runtime_error(
+                    "session: journal record outside the content");
+            }
+            length = length - r.inserted + r.erased;
+        }
+        length = content;
+        for (size_type i = header.journal_applied; i < records.size(); ++i) {
+            const Record& r = records[i];
+            if (outside(r, length, r.erased)) {
+                throw std::runtime_error(
+                    "session: journal record outside the content");
+            }
+            length = length - r.erased + r.inserted;
+        }
+
+        // a reserve too large to be the growth policy's is not restored
+        const size_type capacity =
+            session::keeps_capacity(header)
+                ? static_cast<size_type>(header.capacity)
+                : content + GrowthPolicy::initial_gap(content);
+        GapBuffer buffer(capacity, allocator);
+        buffer.gapStart = buffer.bufferStart + header.prefix;
+        buffer.gapEnd = buffer.bufferEnd - header.suffix;
+        copy(buffer.bufferStart, sections.prefix);
+        copy(buffer.gapEnd, sections.suffix);
+
+        if (header.flags & session::has_line_index) {
+            buffer.lineIndex = std::make_unique<LineIndex>(std::move(blocks));
+        }
+        if constexpr (std::same_as<T, char>) {
+            if (header.flags & session::has_utf8_index) {
+                buffer.utf8Index = std::make_unique<Utf8Index>(
+                    buffer.size(), buffer.utf8_counter());
+            }
         }
+        if (header.flags & session::has_journal) {
+            std::vector<T> arena(header.journal_arena);
+            copy(arena.data(), sections.journal_arena);
+            buffer.journal = std::make_unique<EditJournal<T>>(
+                std::move(records), std::move(arena),
+                static_cast<size_type>(header.journal_applied),
+                (header.flags & session::journal_group_closed) != 0);
+        }
+        return buffer;
+    }
+
+    // Searches run the SIMD kernels over each contiguous segment; matches
+    // straddling the gap are found in a small window stitched across it.
+    // Positions are logical indexes, npos when there is no match.
+    size_type find(const char c, const size_type pos = 0) const
+        requires std::same_as<T, char>
+    {
+        const size_type gapIndex = gap_index();
+        if (pos < gapIndex) {
+            const char* hit =
+                gb::simd::find_byte(bufferStart + pos, gapStart, c);
+            if (hit != gapStart) {
+                return hit - bufferStart;
+            }
+        }
+        const char* from = gapEnd + (pos > gapIndex ? pos - gapIndex : 0);
+        if (from >= bufferEnd) {
+            return npos;
+        }
+        const char* hit = gb::simd::find_byte(from, bufferEnd, c);
+        return (hit != bufferEnd) ? gapIndex + (hit - gapEnd) : npos;
+    }
 
-        if (pos.ptr != gapStart) {
-            // Move the gap to the position of insertion
-            move_gap_to(pos.ptr);
+    size_type find(std::string_view needle, const size_type pos = 0) const
+        requires std::same_as<T, char>
+    {
+        const size_type n = size();
+        const size_type m = needle.size();
+        if (pos > n || n - pos < m) {
+            return npos;
         }
+        if (m == 0) {
+            return pos;
+        }
+
+        const size_type gapIndex = gap_index();
+        if (pos < gapIndex) {
+            const char* hit = gb::simd::find_substr(bufferStart + pos, gapStart,
+                                                    needle.data(), m);
+            if (hit != gapStart) {
+                return hit - bufferStart;
+            }
+            const size_type from = std::max(pos, seam_window_start(m));
+            const std::string window = seam_window(from, m);
+            const size_type hitIndex = window.find(needle);
+            if (hitIndex != std::string::npos) {
+                return from + hitIndex;
+            }
+        }
+
+        const char* from = gapEnd + (pos > gapIndex ? pos - gapIndex : 0);
+        const char* hit =
+            gb::simd::find_substr(from, bufferEnd, needle.data(), m);
+        return (hit != bufferEnd) ? gapIndex + (hit - gapEnd) : npos;
+    }
+
+    size_type rfind(const char c, const size_type pos = npos) const
+        requires std::same_as<T, char>
+    {
+        if (size() == 0) {
+            return npos;
+        }
+        const size_type last = std::min(pos, size() - 1);
+        const size_type gapIndex = gap_index();
+        if (last >= gapIndex) {
+            const char* end = gapEnd + (last - gapIndex) + 1;
+            const char* hit = gb::simd::rfind_byte(gapEnd, end, c);
+            if (hit != end) {
+                return gapIndex + (hit - gapEnd);
+            }
+        }
+        const char* end = bufferStart + std::min(last + 1, gapIndex);
+        const char* hit = gb::simd::rfind_byte(bufferStart, end, c);
+        return (hit != end) ? hit - bufferStart : npos;
+    }
+
+    size_type rfind(std::string_view needle, const size_type pos = npos) const
+        requires std::same_as<T, char>
+    {
+        const size_type n = size();
+        const size_type m = needle.size();
+        if (m > n) {
+            return npos;
+        }
+        const size_type last = std::min(pos, n - m); // last allowed start
+        if (m == 0) {
+            return last;
+        }
+
+        const size_type gapIndex = gap_index();
+        if (last >= gapIndex) {
+            const char* end = gapEnd + (last - gapIndex) + m;
+            const char* hit =
+                gb::simd::rfind_substr(gapEnd, end, needle.data(), m);
+            if (hit != end) {
+                return gapIndex + (hit - gapEnd);
+            }
+        }
+
+        const size_type from = seam_window_start(m);
+        if (from < gapIndex && from <= last) {
+            const std::string window = seam_window(from, m);
+            const size_type hitIndex = window.rfind(needle, last - from);
+            if (hitIndex != std::string::npos) {
+                return from + hitIndex;
+            }
+        }
+
+        const char* end = bufferStart + std::min(gapIndex, last + m);
+        const char* hit =
+            gb::simd::rfind_substr(bufferStart, end, needle.data(), m);
+        return (hit != end) ? hit - bufferStart : npos;
+    }
+
+    // Opt-in undo/redo history kept by insert/erase/push_back/apply_batch.
+    // undo() and redo() step between checkpoints and return false when
+    // there is nothing to step over. The journal keeps copies of what
+    // changed, so it needs copyable elements.
+    void enable_journal()
+        requires std::copy_constructible<T>
+    {
+        journal = std::make_unique<EditJournal<T>>();
+    }
+
+    void disable_journal() noexcept {
+        journal.reset();
+    }
+
+    const EditJournal<T>* get_journal() const noexcept {
+        return journal.get();
+    }
+
+    void checkpoint() noexcept {
+        if (journal) {
+            journal->checkpoint();
+        }
+    }
+
+    bool undo()
+        requires std::copy_constructible<T>
+    {
+        return replay([this](auto& history) {
+            return history.undo(replacer());
+        });
+    }
+
+    bool redo()
+        requires std::copy_constructible<T>
+    {
+        return replay([this](auto& history) {
+            return history.redo(replacer());
+        });
+    }
+
+    // occurrences of c in [from, from + len)
+    size_type count(const char c, const size_type from = 0,
+                    size_type len = npos) const
+        requires std::same_as<T, char>
+    {
+        len = std::min(len, size() - std::min(from, size()));
+        const size_type to = from + len;
+        const size_type gapIndex = gap_index();
+        size_type n = 0;
+        if (from < gapIndex) {
+            n += gb::simd::count_byte(bufferStart + from,
+                                      bufferStart + std::min(to, gapIndex), c);
+        }
+        if (to > gapIndex) {
+            n += gb::simd::count_byte(
+                gapEnd + (std::max(from, gapIndex) - gapIndex),
+                gapEnd + (to - gapIndex), c);
+        }
+        return n;
+    }
+
+    // Optional line index kept current by insert/erase/push_back. With it,
+    // the line queries below cost O(log n) plus a scan of one 4 KiB block;
+    // without it they scan the buffer.
+    void enable_line_index()
+        requires std::same_as<T, char>
+    {
+        lineIndex = std::make_unique<LineIndex>(size(), newline_counter());
+    }
+
+    void disable_line_index() noexcept {
+        lineIndex.reset();
+    }
+
+    bool has_line_index() const noexcept {
+        return lineIndex != nullptr;
+    }
+
+    size_type line_count() const
+        requires std::same_as<T, char>
+    {
+        return 1 + (lineIndex ? lineIndex->newline_count() : count('\n'));
+    }
+
+    // offset of the first character of line (0 based)
+    size_type line_to_offset(const size_type line) const
+        requires std::same_as<T, char>
+    {
+        if (line == 0) {
+            return 0;
+        }
+        size_type from = 0;
+        size_type rank = line - 1;
+        if (lineIndex) {
+            std::tie(from, rank) = lineIndex->locate_newline(line - 1);
+        }
+        size_type newline = find('\n', from);
+        for (; rank > 0 && newline != npos; --rank) {
+            newline = find('\n', newline + 1);
+        }
+        if (newline == npos) {
+            throw std::out_of_range("line out of range");
+        }
+        return newline + 1;
+    }
+
+    LineCol offset_to_line_col(const size_type offset) const
+        requires std::same_as<T, char>
+    {
+        if (offset > size()) {
+            throw std::out_of_range("Out of bounds");
+        }
+        size_type from = 0;
+        size_type line = 0;
+        if (lineIndex) {
+            std::tie(from, line) = lineIndex->locate_offset(offset);
+        }
+        line += count('\n', from, offset - from);
+        return {line, offset - line_to_offset(line)};
+    }
+
+    // UTF-8 mode: validates the content and keeps a Utf8Index current.
+    // While it is on, inserted text must be valid UTF-8 on its own and every
+    // edit must start and end on code point boundaries; anything else throws
+    // std::invalid_argument and leaves the content unchanged. The position
+    // conversions below then cost O(log n) plus a scan of one 4 KiB block;
+    // without the index they scan the buffer.
+    void enable_utf8_index()
+        requires std::same_as<T, char>
+    {
+        move_gap_to(bufferEnd); // one run, so no sequence is cut by the gap
+        if (gb::utf8::validate(bufferStart, gapStart) != gapStart) {
+            throw std::invalid_argument("content is not valid UTF-8");
+        }
+        utf8Index = std::make_unique<Utf8Index>(size(), utf8_counter());
+    }
+
+    void disable_utf8_index() noexcept {
+        utf8Index.reset();
+    }
+
+    bool has_utf8_index() const noexcept {
+        return utf8Index != nullptr;
+    }
+
+    // code points and UTF-16 units starting in [from, from + len)
+    gb::utf8::Counts utf8_counts(const size_type from = 0,
+                                 size_type len = npos) const
+        requires std::same_as<T, char>
+    {
+        len = std::min(len, size() - std::min(from, size()));
+        gb::utf8::Counts counts;
+        for (const auto segment : range_segments(from, len)) {
+            counts += gb::utf8::count(segment.data(),
+                                      segment.data() + segment.size());
+        }
+        return counts;
+    }
+
+    size_type code_point_count() const
+        requires std::same_as<T, char>
+    {
+        return utf8Index ? utf8Index->totals().code_points
+                         : utf8_counts().code_points;
+    }
+
+    size_type utf16_count() const
+        requires std::same_as<T, char>
+    {
+        return utf8Index ? utf8Index->totals().utf16_units
+                         : utf8_counts().utf16_units;
+    }
+
+    // code points starting before the byte offset
+    size_type offset_to_code_point(const size_type offset) const
+        requires std::same_as<T, char>
+    {
+        return utf8_counts_before(offset).code_points;
+    }
+
+    // UTF-16 units of the code points starting before the byte offset
+    size_type offset_to_utf16(const size_type offset) const
+        requires std::same_as<T, char>
+    {
+        return utf8_counts_before(offset).utf16_units;
+    }
+
+    // byte offset of the n-th code point (0 based); n == code_point_count()
+    // maps to size()
+    size_type code_point_to_offset(const size_type n) const
+        requires std::same_as<T, char>
+    {
+        size_type from = 0;
+        size_type rank = n;
+        if (utf8Index) {
+            if (n == utf8Index->totals().code_points) {
+                return size();
+            }
+            std::tie(from, rank) = utf8Index->locate_code_point(n);
+        }
+        return seek_utf8(from, rank, [](const char c) -> size_type {
+            return !gb::utf8::is_continuation(c);
+        });
+    }
+
+    // byte offset of UTF-16 unit n (0 based); the second unit of a surrogate
+    // pair maps to the start of its code point
+    size_type utf16_to_offset(const size_type n) const
+        requires std::same_as<T, char>
+    {
+        size_type from = 0;
+        size_type rank = n;
+        if (utf8Index) {
+            if (n == utf8Index->totals().utf16_units) {
+                return size();
+            }
+            std::tie(from, rank) = utf8Index->locate_utf16(n);
+        }
+        return seek_utf8(from, rank, gb::utf8::utf16_units);
+    }
+
+    // Start of every non-overlapping occurrence, in order
+    std::vector<size_type> find_all(std::string_view needle) const
+        requires std::same_as<T, char>
+    {
+        std::vector<size_type> matches;
+        for_each_occurrence(
+            needle, [&](const size_type pos) { matches.push_back(pos); });
+        return matches;
+    }
+
+    // by value: value may alias an element that reserve_gap moves
+    constexpr void insert(iterator pos, value_type value) {
+        const size_type index = pos - begin();
+        reserve_gap(1);
+        move_gap_to(pointer_at(index));
 
         // Place the value in the gap and adjust gapStart
-        *gapStart = c;
+        std::construct_at(gapStart, std::move(value));
         ++gapStart;
 
         assert(gapStart >= bufferStart && gapStart <= gapEnd);
+        on_inserted(index, 1);
+    }
+
+    // Bulk insert: grows at most once, moves the gap once and block-copies
+    // the range into it
+    template <std::forward_iterator It>
+    constexpr void insert(iterator pos, It first, It last) {
+        const size_type index = pos - begin();
+        const size_type count = std::distance(first, last);
+        if (count == 0) {
+            return;
+        }
+
+        reserve_gap(count);
+        move_gap_to(pointer_at(index));
+        gapStart = std::uninitialized_copy_n(first, count, gapStart);
+
+        assert(gapStart >= bufferStart && gapStart <= gapEnd);
+        on_inserted(index, count);
+    }
+
+    constexpr void insert(iterator pos, std::string_view str) {
+        insert(pos, str.begin(), str.end());
     }
 
     constexpr void erase(iterator pos) {
-        std::copy(pos.ptr + 1, gapStart, pos.ptr);
-        --gapStart;
+        erase(pos, pos + 1);
     }
 
     constexpr void erase(iterator pos, const size_type count) {
-        std::copy(pos.ptr + count, gapStart, pos.ptr);
-        gapStart -= count;
+        erase(pos, pos + count);
+    }
+
+    // Bulk erase: the erased range is absorbed into the gap after a single
+    // gap move, either onto its start or its end, whichever is closer
+    constexpr void erase(iterator first, iterator last) {
+        const size_type index = first - begin();
+        const size_type count = last - first;
+        if (count == 0) {
+            return;
+        }
+
+        on_erasing(index, count);
+        if (gap_index() >= index + count) {
+            move_gap_to(pointer_at(index + count));
+            gapStart -= count;
+            std::destroy_n(gapStart, count);
+        } else {
+            move_gap_to(pointer_at(index));
+            std::destroy_n(gapEnd, count);
+            gapEnd += count;
+        }
+
+        assert(gapStart >= bufferStart && gapStart <= gapEnd);
+        shrink_to_fit();
     }
 
-    constexpr void push_back(const T& value) {
-        if (gapStart == gapEnd) {
-            resize(capacity() * 2);
+    // Replace values.size() elements at index in place, without moving the
+    // gap. Unlike writes through operator[], this keeps the indexes, the
+    // journal and dirty tracking up to date.
+    void overwrite(const size_type index, std::span<const T> values) {
+        const size_type count = values.size();
+        if (index > size() || count > size() - index) {
+            throw std::out_of_range("overwrite: range out of bounds");
         }
-        *gapStart = value;
+        if (count == 0) {
+            return;
+        }
+        if constexpr (std::same_as<T, char>) {
+            if (utf8Index &&
+                (gb::utf8::validate(values.data(), values.data() + count) !=
+                     values.data() + count ||
+                 !on_code_point_boundary(index) ||
+                 !on_code_point_boundary(index + count))) {
+                throw std::invalid_argument("overwrite: invalid UTF-8");
+            }
+        }
+        if (journal) {
+            journal->record(index, range_segments(index, count), values);
+        }
+        if constexpr (std::same_as<T, char>) {
+            if (lineIndex) {
+                lineIndex->erase(index, count, newline_counter());
+            }
+            if (utf8Index) {
+                utf8Index->erase(index, count, utf8_counter());
+            }
+        }
+
+        const size_type gapIndex = gap_index();
+        const size_type front =
+            index < gapIndex ? std::min(count, gapIndex - index) : 0;
+        std::copy_n(values.begin(), front, pointer_at(index));
+        std::copy(values.begin() + front, values.end(),
+                  pointer_at(index + front));
+
+        if constexpr (std::same_as<T, char>) {
+            if (lineIndex) {
+                lineIndex->insert(index, count, newline_counter());
+            }
+            if (utf8Index) {
+                utf8Index->insert(index, count, utf8_counter());
+            }
+        }
+        if (dirty) {
+            dirty->overwritten(index, count);
+        }
+    }
+
+    // Apply edits sorted by offset and non-overlapping (each offset at or
+    // after the previous offset + erase) in one pass: the result is copied
+    // into a single allocation sized for it, leaving the gap at gapAt (an
+    // index into the result; npos puts it after the last edit). An empty
+    // batch is a no-op. A malformed batch throws std::invalid_argument
+    // before anything is touched.
+    void apply_batch(std::span<const Edit> edits, size_type gapAt = npos) {
+        size_type newSize = size();
+        size_type previousEnd = 0;
+        for (const Edit& edit : edits) {
+            if (edit.offset < previousEnd || edit.offset > size() ||
+                edit.erase > size() - edit.offset) {
+                throw std::invalid_argument(
+                    "apply_batch: edits must be sorted, non-overlapping and "
+                    "in bounds");
+            }
+            previousEnd = edit.offset + edit.erase;
+            newSize = newSize - edit.erase + edit.insert.size();
+        }
+        if constexpr (std::same_as<T, char>) {
+            if (utf8Index) {
+                check_utf8_batch(edits);
+            }
+        }
+        if (edits.empty()) {
+            return;
+        }
+        if (gapAt == npos) {
+            gapAt = newSize - (size() - previousEnd);
+        }
+        if (gapAt > newSize) {
+            throw std::out_of_range("apply_batch: gap position out of range");
+        }
+
+        size_type newCapacity = newSize > capacity()
+                                    ? GrowthPolicy::grow(size(), capacity(),
+                                                         newSize)
+                                    : GrowthPolicy::shrink(newSize, capacity());
+        newCapacity = std::max(newCapacity, newSize);
+        const pointer target = acquire(newCapacity);
+        counters.on_reallocate();
+        // inline to inline goes through scratch space
+        gb::detail::InlineStorage<T, InlineCapacity> scratch;
+        const pointer newBuffer =
+            (target == bufferStart) ? scratch.data() : target;
+
+        // everything left of gapAt goes to the front, the rest to the back
+        const size_type suffixSize = newSize - gapAt;
+        size_type written = 0;
+        const auto emit = [&](const_pointer first, const size_type count) {
+            const size_type front =
+                written < gapAt ? std::min(count, gapAt - written) : 0;
+            std::uninitialized_copy_n(first, front, newBuffer + written);
+            written += front;
+            if (count > front) {
+                std::uninitialized_copy_n(
+                    first + front, count - front,
+                    newBuffer + newCapacity - suffixSize + (written - gapAt));
+                written += count - front;
+            }
+        };
+        const auto emitSource = [&](const size_type from,
+                                    const size_type count) {
+            for (const auto segment : range_segments(from, count)) {
+                emit(segment.data(), segment.size());
+            }
+        };
+        size_type read = 0;
+        for (const Edit& edit : edits) {
+            emitSource(read, edit.offset - read);
+            emit(edit.insert.data(), edit.insert.size());
+            read = edit.offset + edit.erase;
+        }
+        emitSource(read, size() - read);
+        assert(written == newSize);
+
+        if (journal) { // one undo step, offsets as if applied in order
+            journal->checkpoint();
+            size_type shift = 0;
+            for (const Edit& edit : edits) {
+                journal->record(edit.offset + shift,
+                                range_segments(edit.offset, edit.erase),
+                                edit.insert);
+                shift += edit.insert.size() - edit.erase;
+            }
+            journal->checkpoint();
+        }
+        if (dirty) {
+            size_type shift = 0;
+            for (const Edit& edit : edits) {
+                dirty->erased(edit.offset + shift, edit.erase);
+                dirty->inserted(edit.offset + shift, edit.insert.size());
+                shift += edit.insert.size() - edit.erase;
+            }
+        }
+
+        destroy_content();
+        if (newBuffer != target) {
+            gb::detail::relocate(newBuffer, gapAt, target);
+            gb::detail::relocate(newBuffer + newCapacity - suffixSize,
+                                 suffixSize, target + newCapacity - suffixSize);
+        }
+        deallocate(bufferStart, capacity());
+        bufferStart = target;
+        gapStart = target + gapAt;
+        gapEnd = target + newCapacity - suffixSize;
+        bufferEnd = target + newCapacity;
+
+        if constexpr (std::same_as<T, char>) {
+            if (lineIndex) {
+                enable_line_index(); // a rebuild costs no more than the batch
+            }
+            if (utf8Index) {
+                utf8Index =
+                    std::make_unique<Utf8Index>(size(), utf8_counter());
+            }
+        }
+    }
+
+    // Replace every occurrence of needle (non-overlapping, as find_all
+    // finds them) with replacement through one apply_batch: the final size
+    // is known before anything moves, so there is a single allocation sized
+    // by the growth policy and one linear copy however many occurrences
+    // there are. gapAt is as for apply_batch, and honoured even when nothing
+    // matches. Returns the number of replacements; an empty needle matches
+    // nothing.
+    size_type replace_all(std::string_view needle,
+                          std::string_view replacement, size_type gapAt = npos)
+        requires std::same_as<T, char>
+    {
+        if (needle.empty()) {
+            place_gap(gapAt);
+            return 0;
+        }
+        std::vector<Edit> edits;
+        for_each_occurrence(needle, [&](const size_type pos) {
+            edits.push_back({pos, needle.size(), replacement});
+        });
+        if (edits.empty()) {
+            place_gap(gapAt);
+        } else {
+            apply_batch(edits, gapAt);
+        }
+        return edits.size();
+    }
+
+    // replace(offset) is called for each occurrence, in order, and returns
+    // an optional string (or string_view into text that outlives the call)
+    // to put there, std::nullopt to keep it. It must not touch the buffer.
+    template <typename Replace>
+        requires std::same_as<T, char> && std::invocable<Replace&, size_type>
+    size_type replace_all(std::string_view needle, Replace&& replace,
+                          size_type gapAt = npos) {
+        if (needle.empty()) {
+            place_gap(gapAt);
+            return 0;
+        }
+        std::string replacements; // all of them, back to back
+        std::vector<size_type> ends;
+        std::vector<Edit> edits;
+        for_each_occurrence(needle, [&](const size_type pos) {
+            const auto replacement = replace(pos);
+            if (replacement) {
+                replacements.append(*replacement);
+                ends.push_back(replacements.size());
+                edits.push_back({pos, needle.size(), {}});
+            }
+        });
+        size_type from = 0;
+        for (size_type i = 0; i < edits.size(); ++i) {
+            edits[i].insert = std::span<const T>(replacements.data() + from,
+                                                 ends[i] - from);
+            from = ends[i];
+        }
+        if (edits.empty()) {
+            place_gap(gapAt);
+        } else {
+            apply_batch(edits, gapAt);
+        }
+        return edits.size();
+    }
+
+    constexpr void push_back(value_type value) {
+        reserve_gap(1);
+        move_gap_to(bufferEnd);
+        std::construct_at(gapStart, std::move(value));
         gapStart++;
+        on_inserted(size() - 1, 1);
     }
 
     void print_with_gap() {
@@ -477,25 +1538,432 @@ public:
         if (target < gapStart) {
             // Move gap backward
             size_type moveSize = gapStart - target;
-            std::uninitialized_copy_n(target, moveSize, gapEnd - moveSize);
-            std::destroy_n(target, moveSize);
+            gb::detail::relocate(target, moveSize, gapEnd - moveSize);
             gapStart = target;
             gapEnd -= moveSize;
-        } else if (target > gapStart) {
-            // Move gap forward
-            size_type moveSize = target - gapStart;
-            std::uninitialized_copy_n(gapEnd, moveSize, gapStart);
-            std::destroy_n(gapEnd, moveSize);
+            counters.on_gap_move(moveSize * sizeof(T));
+        } else if (target > gapEnd) {
+            // Move gap forward (target points past the gap)
+            size_type moveSize = target - gapEnd;
+            gb::detail::relocate(gapEnd, moveSize, gapStart);
             gapStart += moveSize;
             gapEnd += moveSize;
+            counters.on_gap_move(moveSize * sizeof(T));
         }
     }
 
+    // What this buffer has done so far (its own operations only: copies and
+    // moves start from zero)
+    gb::StatsSnapshot stats() const noexcept
+        requires Stats::enabled
+    {
+        return counters.snapshot(gapSize() * sizeof(T));
+    }
+
+    void reset_stats() noexcept
+        requires Stats::enabled
+    {
+        counters.reset();
+    }
+
 private:
+    constexpr size_type gap_index() const {
+        return static_cast<size_type>(gapStart - bufferStart);
+    }
+
+    // move the gap to gapAt, as apply_batch would leave it; npos keeps it
+    void place_gap(const size_type gapAt) {
+        if (gapAt == npos) {
+            return;
+        }
+        if (gapAt > size()) {
+            throw std::out_of_range("replace_all: gap position out of range");
+        }
+        move_gap_to(pointer_at(gapAt));
+    }
+
+    // storage address of the element at a logical index; the index one past
+    // the prefix maps to gapEnd
+    constexpr pointer pointer_at(const size_type index) {
+        return (index < gap_index()) ? bufferStart + index
+                                     : gapEnd + (index - gap_index());
+    }
+
+    // first index from which a match of length m can straddle the gap
+    constexpr size_type seam_window_start(const size_type m) const {
+        return gap_index() > m - 1 ? gap_index() - (m - 1) : 0;
+    }
+
+    // Copy of [from, gapStart) plus up to m - 1 elements after the gap: any
+    // match starting in the prefix part of the window crosses the gap
+    std::string seam_window(const size_type from, const size_type m) const {
+        std::string window(bufferStart + from, gapStart);
+        window.append(gapEnd,
+                      std::min<size_type>(m - 1, bufferEnd - gapEnd));
+        return window;
+    }
+
+    // [from, from + count) as the parts before and after the gap
+    constexpr std::array<std::span<const T>, 2>
+    range_segments(const size_type from, const size_type count) const {
+        const size_type gapIndex = gap_index();
+        if (from >= gapIndex) {
+            return {std::span<const T>(),
+                    std::span<const T>(gapEnd + (from - gapIndex), count)};
+        }
+        const size_type before = std::min(count, gapIndex - from);
+        return {std::span<const T>(bufferStart + from, before),
+                std::span<const T>(gapEnd, count - before)};
+    }
+
+    // f(pos) for the start of every non-overlapping occurrence, in order
+    template <typename F>
+    void for_each_occurrence(std::string_view needle, F&& f) const
+        requires std::same_as<T, char>
+    {
+        const size_type step = std::max<size_type>(needle.size(), 1);
+        for (size_type pos = find(needle); pos != npos && pos < size();
+             pos = find(needle, pos + step)) {
+            f(pos);
+        }
+    }
+
+    auto replacer() {
+        return [this](size_type offset, size_type count,
+                      std::span<const T> elements) {
+            erase(begin() + offset, count);
+            insert(begin() + offset, elements.begin(), elements.end());
+        };
+    }
+
+    // run step on the journal while it is detached, so that the edits it
+    // replays are not recorded again
+    template <typename Step>
+    bool replay(Step&& step) {
+        if (!journal) {
+            return false;
+        }
+        std::unique_ptr<EditJournal<T>> active = std::move(journal);
+        try {
+            const bool stepped = step(*active);
+            journal = std::move(active);
+            return stepped;
+        } catch (...) {
+            journal = std::move(active);
+            throw;
+        }
+    }
+
+    auto newline_counter() const {
+        return [this](size_type from, size_type len) {
+            return count('\n', from, len);
+        };
+    }
+
+    auto utf8_counter() const {
+        return [this](size_type from, size_type len) {
+            return utf8_counts(from, len);
+        };
+    }
+
+    gb::utf8::Counts utf8_counts_before(const size_type offset) const {
+        if (offset > size()) {
+            throw std::out_of_range("Out of bounds");
+        }
+        size_type from = 0;
+        gb::utf8::Counts counts;
+        if (utf8Index) {
+            std::tie(from, counts) = utf8Index->locate_offset(offset);
+        }
+        counts += utf8_counts(from, offset - from);
+        return counts;
+    }
+
+    // Offset of the code point at which `rank` units (units(byte) per lead
+    // byte) have passed, scanning from offset from
+    template <typename Units>
+    size_type seek_utf8(const size_type from, size_type rank,
+                        Units&& units) const {
+        size_type offset = from;
+        for (const auto segment : range_segments(from, size() - from)) {
+            for (const char c : segment) {
+                const size_type n = units(c);
+                if (n > rank) {
+                    return offset;
+                }
+                rank -= n;
+                ++offset;
+            }
+        }
+        if (rank > 0) {
+            throw std::out_of_range("position out of range");
+        }
+        return offset;
+    }
+
+    bool on_code_point_boundary(const size_type index) const {
+        return index >= size() || !gb::utf8::is_continuation((*this)[index]);
+    }
+
+    void check_utf8_batch(std::span<const Edit> edits) const {
+        for (const Edit& edit : edits) {
+            const char* end = edit.insert.data() + edit.insert.size();
+            if (gb::utf8::validate(edit.insert.data(), end) != end ||
+                !on_code_point_boundary(edit.offset) ||
+                !on_code_point_boundary(edit.offset + edit.erase)) {
+                throw std::invalid_argument("apply_batch: invalid UTF-8");
+            }
+        }
+    }
+
+    // called after count elements were inserted at index (they end at
+    // gapStart)
+    void on_inserted(const size_type index, const size_type count) {
+        if constexpr (std::same_as<T, char>) {
+            // in UTF-8 mode, take back an insert that is ill-formed or lands
+            // inside a sequence before anything records it
+            if (utf8Index &&
+                (gb::utf8::validate(gapStart - count, gapStart) != gapStart ||
+                 !on_code_point_boundary(index + count))) {
+                gapStart -= count;
+                throw std::invalid_argument("insert: invalid UTF-8");
+            }
+        }
+        if constexpr (std::copy_constructible<T>) {
+            if (journal) {
+                journal->record(index, {},
+                                std::span<const T>(gapStart - count, count));
+            }
+        }
+        if constexpr (std::same_as<T, char>) {
+            if (lineIndex) {
+                lineIndex->insert(index, count, newline_counter());
+            }
+            if (utf8Index) {
+                utf8Index->insert(index, count, utf8_counter());
+            }
+        }
+        if (dirty) {
+            dirty->inserted(index, count);
+        }
+    }
+
+    // called before count elements at index are erased
+    void on_erasing(const size_type index, const size_type count) {
+        if constexpr (std::same_as<T, char>) {
+            if (utf8Index && (!on_code_point_boundary(index) ||
+                              !on_code_point_boundary(index + count))) {
+                throw std::invalid_argument(
+                    "erase: range splits a UTF-8 sequence");
+            }
+        }
+        if constexpr (std::copy_constructible<T>) {
+            if (journal) {
+                journal->record(index, range_segments(index, count), {});
+            }
+        }
+        if constexpr (std::same_as<T, char>) {
+            if (lineIndex) {
+                lineIndex->erase(index, count, newline_counter());
+            }
+            if (utf8Index) {
+                utf8Index->erase(index, count, utf8_counter());
+            }
+        }
+        if (dirty) {
+            dirty->erased(index, count);
+        }
+    }
+
+    // make room for count more elements with a single reallocation
+    constexpr void reserve_gap(const size_type count) {
+        if (gapSize() < count) {
+            reallocate(GrowthPolicy::grow(size(), capacity(), size() + count));
+        }
+    }
+
+    // move prefix and suffix into a fresh allocation of newCapacity
+    // (newCapacity >= size()), keeping the gap position
+    void reallocate(size_type newCapacity) {
+        if (is_inline() && newCapacity <= InlineCapacity) {
+            return; // inline storage never shrinks
+        }
+        // Allocate new buffer
+        pointer newBuffer = acquire(newCapacity);
+        assert(newBuffer != nullptr);
+        counters.on_reallocate();
+
+        size_type prefixSize = gapStart - bufferStart;
+        size_type suffixSize = bufferEnd - gapEnd;
+
+        // Relocate elements before and after the gap
+        gb::detail::relocate(bufferStart, prefixSize, newBuffer);
+        gb::detail::relocate(gapEnd, suffixSize,
+                             newBuffer + newCapacity - suffixSize);
+
+        // Deallocate old buffer, its elements were moved out
+        deallocate(bufferStart, capacity());
+
+        // Update buffer pointers
+        bufferStart = newBuffer;
+        gapStart = bufferStart + prefixSize;
+        gapEnd = bufferStart + newCapacity - suffixSize;
+        bufferEnd = bufferStart + newCapacity;
+
+        assert(bufferStart != nullptr);
+        assert(bufferEnd == bufferStart + newCapacity);
+        assert(gapStart <= gapEnd);
+    }
+
+    // copy other's content into fresh storage of the same capacity and
+    // layout; *this must not own storage yet
+    void copy_storage(const GapBuffer& other) {
+        size_type capacity = other.capacity();
+        pointer newBuffer = acquire(capacity);
+        const auto [prefix, suffix] = other.segments();
+        std::uninitialized_copy_n(prefix.data(), prefix.size(), newBuffer);
+        std::uninitialized_copy_n(suffix.data(), suffix.size(),
+                                  newBuffer + capacity - suffix.size());
+
+        bufferStart = newBuffer;
+        gapStart = newBuffer + prefix.size();
+        gapEnd = newBuffer + capacity - suffix.size();
+        bufferEnd = newBuffer + capacity;
+    }
+
+    void copy_extras(const GapBuffer& other) {
+        lineIndex = other.lineIndex
+                        ? std::make_unique<LineIndex>(*other.lineIndex)
+                        : nullptr;
+        utf8Index = other.utf8Index
+                        ? std::make_unique<Utf8Index>(*other.utf8Index)
+                        : nullptr;
+        journal = other.journal
+                      ? std::make_unique<EditJournal<T>>(*other.journal)
+                      : nullptr;
+        dirty = other.dirty ? std::make_unique<DirtyRanges>(*other.dirty)
+                            : nullptr;
+    }
+
+    // take other's storage (relocating its elements when inline), leaving
+    // other empty with no capacity; *this must not own storage yet
+    void steal(GapBuffer& other) noexcept {
+        if (other.is_inline()) {
+            const size_type prefixSize = other.gapStart - other.bufferStart;
+            const size_type suffixSize = other.bufferEnd - other.gapEnd;
+            bufferStart = inlineStorage.data();
+            bufferEnd = bufferStart + InlineCapacity;
+            gapStart = bufferStart + prefixSize;
+            gapEnd = bufferEnd - suffixSize;
+            gb::detail::relocate(other.bufferStart, prefixSize, bufferStart);
+            gb::detail::relocate(other.gapEnd, suffixSize, gapEnd);
+            other.bufferStart = other.gapStart = nullptr;
+            other.gapEnd = other.bufferEnd = nullptr;
+        } else {
+            bufferStart = std::exchange(other.bufferStart, nullptr);
+            gapStart = std::exchange(other.gapStart, nullptr);
+            gapEnd = std::exchange(other.gapEnd, nullptr);
+            bufferEnd = std::exchange(other.bufferEnd, nullptr);
+        }
+        lineIndex = std::move(other.lineIndex);
+        utf8Index = std::move(other.utf8Index);
+        journal = std::move(other.journal);
+        dirty = std::move(other.dirty);
+    }
+
+    // Storage for capacity elements: the inline buffer when they fit (the
+    // capacity is then rounded up to all of it), the allocator otherwise
+    pointer acquire(size_type& capacity) {
+        if constexpr (InlineCapacity > 0) {
+            if (capacity <= InlineCapacity) {
+                capacity = InlineCapacity;
+                counters.on_capacity(capacity * sizeof(T));
+                return inlineStorage.data();
+            }
+        }
+        pointer storage = alloc_traits::allocate(alloc, capacity);
+        counters.on_capacity(capacity * sizeof(T));
+        return storage;
+    }
+
+    bool is_inline() const noexcept {
+        return InlineCapacity > 0 && bufferStart == inlineStorage.data();
+    }
+
+    // give back storage whose elements were destroyed or moved out
+    void deallocate(pointer buffer, const size_type count) noexcept {
+        if (buffer && buffer != inlineStorage.data()) {
+            alloc_traits::deallocate(alloc, buffer, count);
+        }
+    }
+
+    void destroy_content() noexcept {
+        std::destroy(bufferStart, gapStart);
+        std::destroy(gapEnd, bufferEnd);
+    }
+
+    void release() noexcept {
+        destroy_content();
+        deallocate(bufferStart, capacity());
+        bufferStart = gapStart = gapEnd = bufferEnd = nullptr;
+    }
+
+    // stateless allocators take no space
+    [[no_unique_address]] allocator_type alloc;
+    [[no_unique_address]] gb::detail::InlineStorage<T, InlineCapacity>
+        inlineStorage;
+    [[no_unique_address]] Stats counters;
+
     // raw pointers like a "raw iterator"
     // support arithmetic and everything but unsafe and less functionality
     pointer bufferStart = nullptr;
     pointer gapStart = nullptr;
     pointer gapEnd = nullptr;
     pointer bufferEnd = nullptr;
+
+    std::unique_ptr<LineIndex> lineIndex;
+    std::unique_ptr<Utf8Index> utf8Index;
+    std::unique_ptr<EditJournal<T>> journal;
+    std::unique_ptr<DirtyRanges> dirty;
 };
+
+namespace gb::pmr {
+// GapBuffer drawing from a std::pmr::memory_resource, e.g. a
+// monotonic_buffer_resource arena for per-request scratch buffers
+template <GapElement T = char,
+          GapGrowthPolicy GrowthPolicy = GeometricGrowth<>>
+using GapBuffer =
+    ::GapBuffer<T, std::pmr::polymorphic_allocator<T>, GrowthPolicy>;
+} // namespace gb::pmr
+
+namespace gb {
+// Allocator for buffers that must never touch the heap: any request fails
+template <typename T>
+struct NullAllocator {
+    using value_type = T;
+
+    NullAllocator() = default;
+    template <typename U>
+    NullAllocator(const NullAllocator<U>&) noexcept {
+    }
+
+    [[noreturn]] T* allocate(std::size_t) {
+        throw std::length_error("fixed capacity exceeded");
+    }
+
+    void deallocate(T*, std::size_t) noexcept {
+    }
+
+    bool operator==(const NullAllocator&) const = default;
+};
+} // namespace gb
+
+// Heap allocates only past N elements (content plus gap)
+template <GapElement T, std::size_t N, class Allocator = std::allocator<T>>
+using SmallGapBuffer = GapBuffer<T, Allocator, GeometricGrowth<>, N>;
+
+// Never allocates: holds at most N elements inline and throws
+// std::length_error, leaving the buffer unchanged, when an insert needs more
+template <GapElement T, std::size_t N>
+using FixedGapBuffer =
+    GapBuffer<T, gb::NullAllocator<T>, GeometricGrowth<>, N>;
@@ -0,0 +1,338 @@
+// Replay a recorded editing trace against one or all buffer backends and
+// report time, per-op latency, final heap footprint and a checksum of the
+// final text.
+//
+//   gbreplay [--backend NAME] [--repeat N] [--save-binary OUT] TRACE
+//
+// TRACE is a JSON or binary trace (see trace.h). --save-binary converts it
+// to the binary format, which loads without parsing. The exit status is 1
+// when a backend's final text differs from the trace's endContent or from
+// another backend's.
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "chunked_gapbuffer.h"
+#include "deque_gb.h"
+#include "gapbuffer.h"
+#include "trace.h"
+
+// Live heap bytes, from a size header in front of every allocation
+namespace {
+std::size_t liveBytes = 0;
+} // namespace
+
+void* operator new(std::size_t size) {
+    constexpr std::size_t header = alignof(std::max_align_t);
+    auto* base = static_cast<char*>(std::malloc(size + header));
+    if (base == nullptr) {
+        throw std::bad_alloc();
+    }
+    *reinterpret_cast<std::size_t*>(base) = size;
+    liveBytes += size;
+    return base + header;
+}
+
+void operator delete(void* p) noexcept {
+    if (p == nullptr) {
+        return;
+    }
+    char* base = static_cast<char*>(p) - alignof(std::max_align_t);
+    liveBytes -= *reinterpret_cast<std::size_t*>(base);
+    std::free(base);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    operator delete(p);
+}
+
+namespace {
+
+using gb::trace::Op;
+using gb::trace::Trace;
+
+struct Result {
+    double totalMs = 0;
+    std::int64_t p50 = 0; // ns
+    std::int64_t p99 = 0;
+    std::size_t memory = 0; // live heap bytes held by the final buffer
+    std::uint64_t checksum = 0;
+    std::string content;
+    std::string extra;
+};
+
+// Each backend takes byte offsets: erase then insert at op.pos
+class GapBufferBackend {
+public:
+    explicit GapBufferBackend(const std::string& start) : gb(start) {
+    }
+
+    void apply(const Op& op) {
+        if (op.erase > 0) {
+            gb.erase(gb.begin() + op.pos, op.erase);
+        }
+        if (!op.text.empty()) {
+            gb.insert(gb.begin() + op.pos, std::string_view(op.text));
+        }
+    }
+
+    void hash(gb::trace::Fnv1a& fnv) const {
+        for (const auto segment : gb.segments()) {
+            fnv.update(segment);
+        }
+    }
+
+    std::string to_string() const {
+        return gb.to_string();
+    }
+
+    std::string extra() const {
+        const gb::StatsSnapshot stats = gb.stats();
+        return std::to_string(stats.gap_moves) + " gap moves, " +
+               std::to_string(stats.bytes_moved >> 20) + " MiB moved, " +
+               std::to_string(stats.reallocations) + " reallocations";
+    }
+
+private:
+    GapBuffer<char, std::allocator<char>, GeometricGrowth<>, 0, gb::GapStats>
+        gb;
+};
+
+class ChunkedBackend {
+public:
+    explicit ChunkedBackend(const std::string& start) : cb(start) {
+    }
+
+    void apply(const Op& op) {
+        if (op.erase > 0) {
+            cb.erase(cb.begin() + op.pos, op.erase);
+        }
+        if (!op.text.empty()) {
+            cb.insert(cb.begin() + op.pos, std::string_view(op.text));
+        }
+    }
+
+    void hash(gb::trace::Fnv1a& fnv) const {
+        const std::string text = cb.to_string();
+        fnv.update(text);
+    }
+
+    std::string to_string() const {
+        return cb.to_string();
+    }
+
+    std::string extra() const {
+        return std::to_string(cb.chunk_count()) + " chunks";
+    }
+
+private:
+    ChunkedGapBuffer<char> cb;
+};
+
+class DequeBackend {
+public:
+    explicit DequeBackend(const std::string& start) {
+        // Gb starts out with demo contents, drop them first
+        gb.move_cursor(gb.size());
+        gb.del(gb.size());
+        gb.insert(start);
+    }
+
+    void apply(const Op& op) {
+        // Gb::del is a backspace, so park the cursor after the erased range
+        if (op.erase > 0) {
+            gb.move_cursor(op.pos + op.erase);
+            gb.del(op.erase);
+        }
+        if (!op.text.empty()) {
+            gb.move_cursor(op.pos);
+            gb.insert(op.text);
+        }
+    }
+
+    void hash(gb::trace::Fnv1a& fnv) const {
+        const std::string text = gb.to_string();
+        fnv.update(text);
+    }
+
+    std::string to_string() const {
+        return gb.to_string();
+    }
+
+    std::string extra() const {
+        const gb::StatsSnapshot stats = gb.stats();
+        return std::to_string(stats.gap_moves) + " cursor moves, " +
+               std::to_string(stats.bytes_moved >> 20) + " MiB spliced";
+    }
+
+private:
+    BasicGb<gb::GapStats> gb;
+};
+
+class StringBackend {
+public:
+    explicit StringBackend(const std::string& start) : str(start) {
+    }
+
+    void apply(const Op& op) {
+        str.replace(op.pos, op.erase, op.text);
+    }
+
+    void hash(gb::trace::Fnv1a& fnv) const {
+        fnv.update(str);
+    }
+
+    std::string to_string() const {
+        return str;
+    }
+
+    std::string extra() const {
+        return {};
+    }
+
+private:
+    std::string str;
+};
+
+std::int64_t percentile(std::vector<std::int64_t>& samples, double p) {
+    if (samples.empty()) {
+        return 0;
+    }
+    const auto nth = samples.begin() + static_cast<std::ptrdiff_t>(
+                                           p * (samples.size() - 1));
+    std::nth_element(samples.begin(), nth, samples.end());
+    return *nth;
+}
+
+template <typename Backend>
+Result replay(const Trace& trace) {
+    using Clock = std::chrono::steady_clock;
+    std::vector<std::int64_t> latencies(trace.ops.size());
+
+    const std::size_t before = liveBytes;
+    Backend backend(trace.start);
+    const Clock::time_point start = Clock::now();
+    Clock::time_point last = start;
+    for (std::size_t i = 0; i < trace.ops.size(); ++i) {
+        backend.apply(trace.ops[i]);
+        const Clock::time_point now = Clock::now();
+        latencies[i] =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now - last)
+                .count();
+        last = now;
+    }
+
+    Result result;
+    result.totalMs =
+        std::chrono::duration<double, std::milli>(last - start).count();
+    result.memory = liveBytes - before;
+    gb::trace::Fnv1a fnv;
+    backend.hash(fnv);
+    result.checksum = fnv.digest();
+    result.content = backend.to_string();
+    result.extra = backend.extra();
+    result.p50 = percentile(latencies, 0.50);
+    result.p99 = percentile(latencies, 0.99);
+    return result;
+}
+
+// New backends only need an entry here
+const std::vector<std::pair<std::string_view,
+                            std::function<Result(const Trace&)>>>
+    backends = {
+        {"GapBuffer", replay<GapBufferBackend>},
+        {"ChunkedGapBuffer", replay<ChunkedBackend>},
+        {"Gb", replay<DequeBackend>},
+        {"std::string", replay<StringBackend>},
+};
+
+int usage() {
+    std::cerr << "usage: gbreplay [--backend NAME] [--repeat N] "
+                 "[--save-binary OUT] TRACE\nbackends:";
+    for (const auto& [name, _] : backends) {
+        std::cerr << ' ' << name;
+    }
+    std::cerr << '\n';
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string backendName;
+    std::string savePath;
+    std::string tracePath;
+    int repeat = 1;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg == "--backend" && i + 1 < argc) {
+            backendName = argv[++i];
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--save-binary" && i + 1 < argc) {
+            savePath = argv[++i];
+        } else if (tracePath.empty() && !arg.starts_with("--")) {
+            tracePath = arg;
+        } else {
+            return usage();
+        }
+    }
+    if (tracePath.empty()) {
+        return usage();
+    }
+
+    try {
+        const Trace trace = gb::trace::load(tracePath);
+        std::cout << tracePath << ": " << trace.ops.size() << " ops, "
+                  << trace.start.size() << " B start content\n";
+        if (!savePath.empty()) {
+            gb::trace::save_binary(trace, savePath);
+            std::cout << "saved binary trace to " << savePath << '\n';
+        }
+
+        bool ok = true;
+        bool matched = false;
+        // without an endContent, backends are checked against the first
+        std::optional<std::string> reference = trace.end;
+        for (const auto& [name, run] : backends) {
+            if (!backendName.empty() && name != backendName) {
+                continue;
+            }
+            matched = true;
+            for (int r = 0; r < repeat; ++r) {
+                const Result result = run(trace);
+                if (!reference) {
+                    reference = result.content;
+                }
+                const bool same = result.content == *reference;
+                ok = ok && same;
+                std::printf("%-18s %10.2f ms  p50 %6lld ns  p99 %8lld ns  "
+                            "%10zu B  fnv %016llx %s  %s\n",
+                            std::string(name).c_str(), result.totalMs,
+                            static_cast<long long>(result.p50),
+                            static_cast<long long>(result.p99), result.memory,
+                            static_cast<unsigned long long>(result.checksum),
+                            same ? "ok" : "MISMATCH", result.extra.c_str());
+            }
+        }
+        if (!matched) {
+            return usage();
+        }
+        return ok ? 0 : 1;
+    } catch (const std::exception& e) {
+        std::cerr << "gbreplay: " << e.what() << '\n';
+        return 2;
+    }
+}
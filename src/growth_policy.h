@@ -0,0 +1,104 @@
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <limits>
+
+// A growth policy decides how much gap a GapBuffer keeps:
+//   default_capacity           capacity of a default constructed buffer
+//   initial_gap(size)          gap added when constructing from content
+//   grow(size, cap, required)  capacity to reallocate to once the gap is too
+//                              small to hold `required` elements in total
+//   shrink(size, cap)          capacity to shrink to after an erase; returning
+//                              cap keeps the current allocation
+template <typename P>
+concept GapGrowthPolicy = requires(std::size_t n) {
+    { P::default_capacity } -> std::convertible_to<std::size_t>;
+    { P::initial_gap(n) } -> std::convertible_to<std::size_t>;
+    { P::grow(n, n, n) } -> std::convertible_to<std::size_t>;
+    { P::shrink(n, n) } -> std::convertible_to<std::size_t>;
+};
+
+// Multiply the capacity by Num/Den on every growth, never leaving more than
+// MaxGap free. Shrinks back once the buffer is two growth steps oversized.
+template <std::size_t Num = 2, std::size_t Den = 1,
+          std::size_t MaxGap = std::numeric_limits<std::size_t>::max()>
+struct GeometricGrowth {
+    static_assert(Num > Den, "growth factor must be greater than 1");
+
+    static constexpr std::size_t default_capacity = 32;
+
+    static constexpr std::size_t initial_gap(std::size_t) {
+        return std::min<std::size_t>(8, MaxGap);
+    }
+
+    static constexpr std::size_t grow(std::size_t size, std::size_t capacity,
+                                      std::size_t required) {
+        std::size_t newCapacity = std::max(capacity * Num / Den, required);
+        if (newCapacity - size > MaxGap) {
+            newCapacity = std::max(required, size + MaxGap);
+        }
+        return newCapacity;
+    }
+
+    static constexpr std::size_t shrink(std::size_t size,
+                                        std::size_t capacity) {
+        const std::size_t oneStep = size * Num / Den;
+        const std::size_t twoSteps = oneStep * Num / Den;
+        if (capacity <= default_capacity || capacity <= twoSteps) {
+            return capacity;
+        }
+        return std::max(oneStep, default_capacity);
+    }
+};
+
+// Always keep a gap of exactly Gap elements after growing; tiny buffers stay
+// tiny and large ones never over-allocate. Shrinks once the gap exceeds
+// four times Gap.
+template <std::size_t Gap = 64>
+struct FixedGapGrowth {
+    static_assert(Gap > 0, "gap must not be empty");
+
+    static constexpr std::size_t default_capacity = Gap;
+
+    static constexpr std::size_t initial_gap(std::size_t) {
+        return Gap;
+    }
+
+    static constexpr std::size_t grow(std::size_t, std::size_t,
+                                      std::size_t required) {
+        return required + Gap;
+    }
+
+    static constexpr std::size_t shrink(std::size_t size,
+                                        std::size_t capacity) {
+        return (capacity - size > 4 * Gap) ? size + Gap : capacity;
+    }
+};
+
+// Keep a gap of Percent% of the content, clamped to [MinGap, MaxGap]. Shrinks
+// once the gap exceeds four times its target.
+template <std::size_t Percent = 25, std::size_t MinGap = 16,
+          std::size_t MaxGap = std::size_t{1} << 20>
+struct ProportionalGrowth {
+    static_assert(Percent > 0 && MinGap > 0 && MinGap <= MaxGap);
+
+    static constexpr std::size_t default_capacity = MinGap;
+
+    static constexpr std::size_t initial_gap(std::size_t size) {
+        return std::clamp(size / 100 * Percent + size % 100 * Percent / 100,
+                          MinGap, MaxGap);
+    }
+
+    static constexpr std::size_t grow(std::size_t, std::size_t,
+                                      std::size_t required) {
+        return required + initial_gap(required);
+    }
+
+    static constexpr std::size_t shrink(std::size_t size,
+                                        std::size_t capacity) {
+        const std::size_t target = initial_gap(size);
+        return (capacity - size > 4 * target) ? size + target : capacity;
+    }
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+
+#include "block_count_index.h"
+
+struct LineCol {
+    std::size_t line = 0;
+    std::size_t column = 0;
+
+    bool operator==(const LineCol&) const = default;
+};
+
+struct NewlineCounter {
+    using units_type = std::size_t;
+    static constexpr std::size_t fields = 1;
+
+    static std::size_t field(const units_type newlines, std::size_t) {
+        return newlines;
+    }
+};
+
+// Newline counts per block of text (see BlockCountIndex); a block's units
+// are its newlines.
+class LineIndex : public BlockCountIndex<NewlineCounter> {
+public:
+    using BlockCountIndex::BlockCountIndex;
+
+    size_type newline_count() const {
+        return total(0);
+    }
+
+    // Start offset of the block holding the n-th newline (0 based), and that
+    // newline's rank inside the block
+    std::pair<size_type, size_type> locate_newline(const size_type n) const {
+        if (n >= newline_count()) {
+            throw std::out_of_range("line out of range");
+        }
+        return locate_unit(0, n);
+    }
+
+    // Start offset of the block holding offset, and the number of newlines
+    // before that block
+    std::pair<size_type, size_type> locate_offset(const size_type offset) const {
+        const auto [index, start] = block_at(offset);
+        return {start, units_before(0, index)};
+    }
+};
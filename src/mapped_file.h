@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only, private mapping of a whole file. Pages are only faulted in when
+// they are read. The file must not be truncated while mapped.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(),
+                                    "open " + path);
+        }
+
+        struct stat st {};
+        if (::fstat(fd, &st) != 0) {
+            const int err = errno;
+            ::close(fd);
+            throw std::system_error(err, std::generic_category(),
+                                    "fstat " + path);
+        }
+
+        length = static_cast<std::size_t>(st.st_size);
+        if (length > 0) {
+            void* addr = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                const int err = errno;
+                ::close(fd);
+                throw std::system_error(err, std::generic_category(),
+                                        "mmap " + path);
+            }
+            mapping = static_cast<const std::byte*>(addr);
+        }
+        ::close(fd); // the mapping keeps the file referenced
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (mapping) {
+            ::munmap(const_cast<std::byte*>(mapping), length);
+        }
+    }
+
+    const std::byte* data() const noexcept {
+        return mapping;
+    }
+
+    std::size_t size() const noexcept {
+        return length;
+    }
+
+private:
+    const std::byte* mapping = nullptr;
+    std::size_t length = 0;
+};
@@ -0,0 +1,297 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "simd_search.h"
+#include "thread_pool.h"
+#include "utf8.h"
+
+// Data-parallel algorithms over a GapBuffer (anything with segments(),
+// size() and operator[]). Each segment is cut into tiles of about an L2
+// cache, so no tile straddles the gap, and the tiles run on a ThreadPool.
+// Per-tile results are combined in tile order and searches look across
+// tile and gap boundaries, so every result is the sequential one.
+namespace gb::parallel {
+
+inline constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+struct Options {
+    ThreadPool* pool = nullptr;         // ThreadPool::shared() when null
+    std::size_t tileBytes = 256 * 1024; // about one L2 cache
+};
+
+// A contiguous piece of a buffer and the index of its first element
+template <typename T>
+struct Tile {
+    std::span<T> elements;
+    std::size_t offset;
+};
+
+namespace detail {
+
+template <typename Segments>
+auto tiles(const Segments& segments, const std::size_t tileBytes) {
+    using Span = std::ranges::range_value_t<Segments>;
+    using T = typename Span::element_type;
+    const std::size_t perTile =
+        std::max<std::size_t>(1, tileBytes / sizeof(T));
+    std::vector<Tile<T>> result;
+    std::size_t offset = 0;
+    for (const Span segment : segments) {
+        for (std::size_t i = 0; i < segment.size(); i += perTile) {
+            const std::size_t n = std::min(perTile, segment.size() - i);
+            result.push_back({segment.subspan(i, n), offset + i});
+        }
+        offset += segment.size();
+    }
+    return result;
+}
+
+inline ThreadPool& pool_of(const Options& options) {
+    return options.pool ? *options.pool : ThreadPool::shared();
+}
+
+// Lower target to value, unless it is already lower
+inline void lower_to(std::atomic<std::size_t>& target, std::size_t value) {
+    std::size_t current = target.load(std::memory_order_relaxed);
+    while (value < current &&
+           !target.compare_exchange_weak(current, value,
+                                         std::memory_order_relaxed)) {
+    }
+}
+
+template <typename Buffer>
+using element_t = typename std::remove_cvref_t<Buffer>::value_type;
+
+} // namespace detail
+
+// f(elements, offset) for every tile, concurrently. Elements are mutable
+// when buffer is.
+template <typename Buffer, typename F>
+void for_each_chunk(Buffer& buffer, F&& f, const Options& options = {}) {
+    const auto tiles = detail::tiles(buffer.segments(), options.tileBytes);
+    detail::pool_of(options).run(tiles.size(), [&](const std::size_t i) {
+        f(tiles[i].elements, tiles[i].offset);
+    });
+}
+
+// combine(...combine(init, map(tile 0)), ..., map(tile n - 1)), where
+// map(elements, offset) runs concurrently. Tiles are folded in order, so
+// combine only has to be associative.
+template <typename Buffer, typename R, typename Map, typename Combine>
+R reduce(const Buffer& buffer, R init, Map&& map, Combine&& combine,
+         const Options& options = {}) {
+    const auto tiles = detail::tiles(buffer.segments(), options.tileBytes);
+    std::vector<std::optional<R>> partial(tiles.size());
+    detail::pool_of(options).run(tiles.size(), [&](const std::size_t i) {
+        partial[i].emplace(map(tiles[i].elements, tiles[i].offset));
+    });
+    for (std::optional<R>& result : partial) {
+        init = combine(std::move(init), std::move(*result));
+    }
+    return init;
+}
+
+// Elements equal to value; newlines, for a line count
+template <typename Buffer, typename V>
+std::size_t count(const Buffer& buffer, const V& value,
+                  const Options& options = {}) {
+    using T = detail::element_t<Buffer>;
+    return reduce(
+        buffer, std::size_t{0},
+        [&value](const std::span<const T> tile, std::size_t) -> std::size_t {
+            if constexpr (std::same_as<T, char>) {
+                return gb::simd::count_byte(tile.data(),
+                                            tile.data() + tile.size(), value);
+            } else {
+                return std::count(tile.begin(), tile.end(), value);
+            }
+        },
+        std::plus<>(), options);
+}
+
+// Index of the first element satisfying pred, npos when there is none.
+// Tiles past a match already found are skipped.
+template <typename Buffer, typename Pred>
+std::size_t find_first_if(const Buffer& buffer, Pred&& pred,
+                          const Options& options = {}) {
+    using T = detail::element_t<Buffer>;
+    std::atomic<std::size_t> first = npos;
+    for_each_chunk(
+        buffer,
+        [&](const std::span<const T> tile, const std::size_t offset) {
+            if (offset >= first.load(std::memory_order_relaxed)) {
+                return;
+            }
+            const auto hit = std::find_if(tile.begin(), tile.end(), pred);
+            if (hit != tile.end()) {
+                detail::lower_to(first, offset + (hit - tile.begin()));
+            }
+        },
+        options);
+    return first.load();
+}
+
+template <typename Buffer, typename V>
+    requires std::equality_comparable_with<detail::element_t<Buffer>, V>
+std::size_t find_first(const Buffer& buffer, const V& value,
+                       const Options& options = {}) {
+    using T = detail::element_t<Buffer>;
+    if constexpr (std::same_as<T, char>) {
+        std::atomic<std::size_t> first = npos;
+        for_each_chunk(
+            buffer,
+            [&](const std::span<const T> tile, const std::size_t offset) {
+                if (offset >= first.load(std::memory_order_relaxed)) {
+                    return;
+                }
+                const char* end = tile.data() + tile.size();
+                const char* hit = gb::simd::find_byte(tile.data(), end, value);
+                if (hit != end) {
+                    detail::lower_to(first, offset + (hit - tile.data()));
+                }
+            },
+            options);
+        return first.load();
+    } else {
+        return find_first_if(
+            buffer, [&value](const T& x) { return x == value; }, options);
+    }
+}
+
+// Start of the first occurrence of needle. A tile owns the matches that
+// start in it: those that run into the next tile, or across the gap, are
+// looked for in a window of the 2 * (size - 1) bytes around its end.
+template <typename Buffer>
+    requires std::same_as<detail::element_t<Buffer>, char>
+std::size_t find_first(const Buffer& buffer, const std::string_view needle,
+                       const Options& options = {}) {
+    const std::size_t m = needle.size();
+    if (m == 0 || m > buffer.size()) {
+        return m == 0 ? 0 : npos;
+    }
+    std::atomic<std::size_t> first = npos;
+    for_each_chunk(
+        buffer,
+        [&](const std::span<const char> tile, const std::size_t offset) {
+            if (offset >= first.load(std::memory_order_relaxed)) {
+                return;
+            }
+            const char* end = tile.data() + tile.size();
+            const char* hit =
+                gb::simd::find_substr(tile.data(), end, needle.data(), m);
+            if (hit != end) {
+                detail::lower_to(first, offset + (hit - tile.data()));
+                return;
+            }
+            const std::size_t tileEnd = offset + tile.size();
+            const std::size_t from =
+                tileEnd - std::min(tile.size(), m - 1);
+            const std::size_t to = std::min(buffer.size(), tileEnd + m - 1);
+            std::string window(to - from, '\0');
+            for (std::size_t i = from; i < to; ++i) {
+                window[i - from] = buffer[i];
+            }
+            const std::size_t at = window.find(needle);
+            if (at != std::string::npos) {
+                detail::lower_to(first, from + at);
+            }
+        },
+        options);
+    return first.load();
+}
+
+// Replace every element x with f(x), in place. Like writes through
+// operator[], this is not seen by the journal, the indexes or dirty
+// tracking.
+template <typename Buffer, typename F>
+void transform(Buffer& buffer, F&& f, const Options& options = {}) {
+    using T = detail::element_t<Buffer>;
+    for_each_chunk(
+        buffer,
+        [&f](const std::span<T> tile, std::size_t) {
+            std::transform(tile.begin(), tile.end(), tile.begin(), f);
+        },
+        options);
+}
+
+// Index of the first byte of the first ill-formed UTF-8 sequence, npos when
+// the buffer is valid. A tile starts after a sequence that began in the
+// previous tile, and settles a sequence cut by its own end in a small copy
+// of the bytes around it, so the gap can be inside a sequence.
+template <typename Buffer>
+    requires std::same_as<detail::element_t<Buffer>, char>
+std::size_t validate_utf8(const Buffer& buffer, const Options& options = {}) {
+    const std::size_t size = buffer.size();
+    const auto sequence_length = [](const char lead) -> std::size_t {
+        const auto byte = static_cast<unsigned char>(lead);
+        return byte < 0xC0 ? 1 : byte < 0xE0 ? 2 : byte < 0xF0 ? 3 : 4;
+    };
+    std::atomic<std::size_t> first = npos;
+    for_each_chunk(
+        buffer,
+        [&](const std::span<const char> tile, const std::size_t offset) {
+            if (offset >= first.load(std::memory_order_relaxed)) {
+                return;
+            }
+            // skip the tail of a sequence led from the previous tile
+            std::size_t skip = 0;
+            for (std::size_t back = 1; back <= std::min<std::size_t>(3, offset);
+                 ++back) {
+                const char c = buffer[offset - back];
+                if (!gb::utf8::is_continuation(c)) {
+                    if (sequence_length(c) > back) {
+                        skip = std::min(sequence_length(c) - back,
+                                        tile.size());
+                        // only continuation bytes belong to it
+                        for (std::size_t i = 0; i < skip; ++i) {
+                            if (!gb::utf8::is_continuation(tile[i])) {
+                                skip = i;
+                                break;
+                            }
+                        }
+                    }
+                    break;
+                }
+            }
+
+            const char* begin = tile.data() + skip;
+            const char* end = tile.data() + tile.size();
+            const char* bad = gb::utf8::validate(begin, end);
+            if (bad == end) {
+                return;
+            }
+            const std::size_t at = offset + (bad - tile.data());
+            if (end - bad < 4 && at + (end - bad) < size) {
+                // possibly a sequence cut by the tile: check it whole
+                char window[4];
+                const std::size_t n = std::min<std::size_t>(4, size - at);
+                for (std::size_t i = 0; i < n; ++i) {
+                    window[i] = buffer[at + i];
+                }
+                const std::size_t length = sequence_length(window[0]);
+                if (length > static_cast<std::size_t>(end - bad) &&
+                    length <= n &&
+                    gb::utf8::validate(window, window + length) ==
+                        window + length) {
+                    return;
+                }
+            }
+            detail::lower_to(first, at);
+        },
+        options);
+    return first.load();
+}
+
+} // namespace gb::parallel
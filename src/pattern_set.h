@@ -0,0 +1,944 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Many patterns, one pass. A PatternSet compiles its literals into one
+// Aho-Corasick automaton (a full byte DFA) and its regexes into one Pike VM
+// program. A Scanner runs both over any sequence of chunks, carrying their
+// state from one chunk to the next; find_all(buffer) feeds it the two
+// segments of a GapBuffer, so the inner loop never tests for the gap and K
+// literals cost a single scan.
+//
+// Each pattern reports its non-overlapping matches from left to right, like
+// GapBuffer::find_all. Regex matches are leftmost-longest (POSIX) and empty
+// matches are not reported. Matching is on bytes.
+//
+// Regexes are not always a single scan: once a regex has a match, it keeps
+// looking for a longer or further left one, and after reporting the match
+// it restarts at its end by replaying the bytes seen since. "a.*b|a" over a
+// run of a's would replay the whole run for every match, so the look for a
+// better match stops maxLookahead bytes past the end of the best one. A
+// regex then costs at most O(n * maxLookahead) steps on n bytes, and keeps
+// about maxLookahead bytes of history; a match that needs more look-ahead
+// to be found is reported as the best one found within it.
+//
+// Regex syntax: literal bytes, ., [...] and [^...] with ranges, \d \w \s
+// and their negations, \b \B, \n \t \r \f \v \xHH, escaped punctuation,
+// groups, |, * + ? {m} {m,} {m,n}, and ^ $ matching at line boundaries.
+namespace gb {
+
+inline constexpr std::size_t default_regex_lookahead = 256;
+
+struct Pattern {
+    enum class Kind { literal, regex };
+
+    Kind kind = Kind::literal;
+    std::string text;
+
+    static Pattern literal(std::string_view text) {
+        return {Kind::literal, std::string(text)};
+    }
+
+    static Pattern regex(std::string_view text) {
+        return {Kind::regex, std::string(text)};
+    }
+};
+
+namespace detail {
+
+using ByteSet = std::bitset<256>;
+
+enum class Assertion { line_start, line_end, word_boundary, not_word_boundary };
+
+struct RegexNode {
+    enum class Kind { bytes, assertion, concat, alternate, repeat };
+
+    explicit RegexNode(const Kind kind = Kind::concat) : kind(kind) {
+    }
+
+    Kind kind;
+    ByteSet bytes;
+    Assertion assertion = Assertion::line_start;
+    int min = 0;
+    int max = 0; // unbounded when negative
+    std::vector<RegexNode> children;
+};
+
+inline ByteSet byte_range(const unsigned char lo, const unsigned char hi) {
+    ByteSet set;
+    for (unsigned c = lo; c <= hi; ++c) {
+        set.set(c);
+    }
+    return set;
+}
+
+inline ByteSet word_bytes() {
+    ByteSet set = byte_range('a', 'z') | byte_range('A', 'Z') |
+                  byte_range('0', '9');
+    set.set('_');
+    return set;
+}
+
+inline ByteSet space_bytes() {
+    ByteSet set;
+    for (const char c : std::string_view(" \t\n\r\f\v")) {
+        set.set(static_cast<unsigned char>(c));
+    }
+    return set;
+}
+
+// Recursive descent over the syntax above, into a RegexNode tree
+class RegexParser {
+public:
+    // bound on {m,n} counts, which are expanded when compiling
+    static constexpr int max_repeat = 1000;
+
+    explicit RegexParser(std::string_view pattern) : pattern(pattern) {
+    }
+
+    RegexNode parse() {
+        RegexNode node = alternation();
+        if (more()) {
+            fail("unmatched )");
+        }
+        return node;
+    }
+
+private:
+    using Kind = RegexNode::Kind;
+
+    [[noreturn]] void fail(const std::string& what) const {
+        throw std::invalid_argument("regex \"" + std::string(pattern) +
+                                    "\": " + what + " at " +
+                                    std::to_string(pos));
+    }
+
+    bool more() const {
+        return pos < pattern.size();
+    }
+
+    unsigned char next() {
+        if (!more()) {
+            fail("unexpected end");
+        }
+        return static_cast<unsigned char>(pattern[pos++]);
+    }
+
+    bool accept(const char c) {
+        if (more() && pattern[pos] == c) {
+            ++pos;
+            return true;
+        }
+        return false;
+    }
+
+    RegexNode alternation() {
+        RegexNode first = concatenation();
+        if (!accept('|')) {
+            return first;
+        }
+        RegexNode node{Kind::alternate};
+        node.children.push_back(std::move(first));
+        do {
+            node.children.push_back(concatenation());
+        } while (accept('|'));
+        return node;
+    }
+
+    RegexNode concatenation() {
+        RegexNode node{Kind::concat};
+        while (more() && pattern[pos] != '|' && pattern[pos] != ')') {
+            node.children.push_back(repetition());
+        }
+        return node;
+    }
+
+    RegexNode repetition() {
+        RegexNode node = atom();
+        while (more()) {
+            int min = 0;
+            int max = -1;
+            if (accept('+')) {
+                min = 1;
+            } else if (accept('?')) {
+                max = 1;
+            } else if (accept('{')) {
+                min = max = number();
+                if (accept(',')) {
+                    max = (more() && pattern[pos] == '}') ? -1 : number();
+                }
+                if (!accept('}')) {
+                    fail("expected }");
+                }
+                if (max >= 0 && max < min) {
+                    fail("bad repeat count");
+                }
+            } else if (!accept('*')) {
+                break;
+            }
+            if (node.kind == Kind::assertion) {
+                fail("nothing to repeat");
+            }
+            RegexNode repeat{Kind::repeat};
+            repeat.min = min;
+            repeat.max = max;
+            repeat.children.push_back(std::move(node));
+            node = std::move(repeat);
+        }
+        return node;
+    }
+
+    int number() {
+        int n = 0;
+        const std::size_t first = pos;
+        while (more() && pattern[pos] >= '0' && pattern[pos] <= '9') {
+            n = n * 10 + (pattern[pos++] - '0');
+            if (n > max_repeat) {
+                fail("repeat count above " + std::to_string(max_repeat));
+            }
+        }
+        if (pos == first) {
+            fail("expected a number");
+        }
+        return n;
+    }
+
+    static RegexNode bytes(const ByteSet& set) {
+        RegexNode node{Kind::bytes};
+        node.bytes = set;
+        return node;
+    }
+
+    static RegexNode assertion(const Assertion assertion) {
+        RegexNode node{Kind::assertion};
+        node.assertion = assertion;
+        return node;
+    }
+
+    RegexNode atom() {
+        const unsigned char c = next();
+        switch (c) {
+        case '(': {
+            RegexNode node = alternation();
+            if (!accept(')')) {
+                fail("expected )");
+            }
+            return node;
+        }
+        case '[':
+            return bytes(bracket());
+        case '.':
+            return bytes(~byte_range('\n', '\n'));
+        case '^':
+            return assertion(Assertion::line_start);
+        case '$':
+            return assertion(Assertion::line_end);
+        case '\\':
+            if (accept('b')) {
+                return assertion(Assertion::word_boundary);
+            }
+            if (accept('B')) {
+                return assertion(Assertion::not_word_boundary);
+            }
+            return bytes(escape());
+        case '*':
+        case '+':
+        case '?':
+        case '{':
+            --pos;
+            fail("nothing to repeat");
+        default:
+            return bytes(byte_range(c, c));
+        }
+    }
+
+    // the bytes named by the escape after a backslash
+    ByteSet escape() {
+        const unsigned char c = next();
+        switch (c) {
+        case 'd':
+            return byte_range('0', '9');
+        case 'D':
+            return ~byte_range('0', '9');
+        case 'w':
+            return word_bytes();
+        case 'W':
+            return ~word_bytes();
+        case 's':
+            return space_bytes();
+        case 'S':
+            return ~space_bytes();
+        case 'n':
+            return byte_range('\n', '\n');
+        case 't':
+            return byte_range('\t', '\t');
+        case 'r':
+            return byte_range('\r', '\r');
+        case 'f':
+            return byte_range('\f', '\f');
+        case 'v':
+            return byte_range('\v', '\v');
+        case 'x': {
+            const unsigned value = hex_digit() * 16 + hex_digit();
+            return byte_range(value, value);
+        }
+        default:
+            if (word_bytes().test(c)) {
+                --pos;
+                fail("unknown escape");
+            }
+            return byte_range(c, c);
+        }
+    }
+
+    unsigned hex_digit() {
+        const unsigned char c = next();
+        if (c >= '0' && c <= '9') {
+            return c - '0';
+        }
+        if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+            return (c | 0x20) - 'a' + 10;
+        }
+        --pos;
+        fail("expected a hex digit");
+    }
+
+    // [...] after the [; a ] right after [ or [^ is a literal
+    ByteSet bracket() {
+        const bool negate = accept('^');
+        ByteSet set;
+        bool first = true;
+        while (first || !accept(']')) {
+            first = false;
+            unsigned char lo = next();
+            if (lo == '\\') {
+                const ByteSet escaped = escape();
+                if (escaped.count() != 1) {
+                    set |= escaped; // a class like \d ends no range
+                    continue;
+                }
+                lo = static_cast<unsigned char>(single(escaped));
+            }
+            unsigned char hi = lo;
+            if (pos + 1 < pattern.size() && pattern[pos] == '-' &&
+                pattern[pos + 1] != ']') {
+                ++pos;
+                hi = next();
+                if (hi == '\\') {
+                    const ByteSet escaped = escape();
+                    if (escaped.count() != 1) {
+                        fail("bad range");
+                    }
+                    hi = static_cast<unsigned char>(single(escaped));
+                }
+                if (hi < lo) {
+                    fail("bad range");
+                }
+            }
+            set |= byte_range(lo, hi);
+        }
+        return negate ? ~set : set;
+    }
+
+    static unsigned single(const ByteSet& set) {
+        unsigned c = 0;
+        while (!set.test(c)) {
+            ++c;
+        }
+        return c;
+    }
+
+    std::string_view pattern;
+    std::size_t pos = 0;
+};
+
+// Pike VM program: bytes consumes one byte of sets[x]; split forks to x
+// and y (both are followed, priority goes by start offset, not branch);
+// jump goes to x; assertion checks Assertion(x) without consuming; match
+// ends a match of regex x.
+struct Instruction {
+    enum class Op : std::uint8_t { bytes, split, jump, assertion, match };
+
+    Op op;
+    std::uint32_t x = 0;
+    std::uint32_t y = 0;
+};
+
+struct Program {
+    // bound on the instructions of one regex after {m,n} expansion
+    static constexpr std::size_t max_size = 1 << 16;
+
+    std::vector<Instruction> code;
+    std::vector<ByteSet> sets;
+    std::vector<std::uint32_t> starts; // first instruction of each regex
+    // bytes a non-empty match of each regex can start with, and of any
+    std::vector<ByteSet> firsts;
+    ByteSet anyFirst;
+
+    void add(const std::string_view pattern) {
+        const std::size_t first = code.size();
+        const std::uint32_t regex = static_cast<std::uint32_t>(starts.size());
+        starts.push_back(static_cast<std::uint32_t>(first));
+        emit(RegexParser(pattern).parse(), first);
+        code.push_back({Instruction::Op::match, regex});
+        if (code.size() - first > max_size) {
+            throw std::invalid_argument("regex \"" + std::string(pattern) +
+                                        "\": too large");
+        }
+        firsts.push_back(first_bytes(starts.back()));
+        anyFirst |= firsts.back();
+    }
+
+private:
+    // the bytes instructions reachable from pc without consuming accept,
+    // taking every assertion as true
+    ByteSet first_bytes(const std::uint32_t pc) const {
+        ByteSet result;
+        std::vector<bool> seen(code.size(), false);
+        std::vector<std::uint32_t> stack = {pc};
+        while (!stack.empty()) {
+            const std::uint32_t at = stack.back();
+            stack.pop_back();
+            if (seen[at]) {
+                continue;
+            }
+            seen[at] = true;
+            const Instruction& in = code[at];
+            switch (in.op) {
+            case Instruction::Op::bytes:
+                result |= sets[in.x];
+                break;
+            case Instruction::Op::split:
+                stack.push_back(in.y);
+                stack.push_back(in.x);
+                break;
+            case Instruction::Op::jump:
+                stack.push_back(in.x);
+                break;
+            case Instruction::Op::assertion:
+                stack.push_back(at + 1);
+                break;
+            case Instruction::Op::match:
+                break;
+            }
+        }
+        return result;
+    }
+
+    std::uint32_t here() const {
+        return static_cast<std::uint32_t>(code.size());
+    }
+
+    std::size_t push(const Instruction::Op op, const std::uint32_t x = 0) {
+        code.push_back({op, x});
+        return code.size() - 1;
+    }
+
+    void emit(const RegexNode& node, const std::size_t first) {
+        using Op = Instruction::Op;
+        using Kind = RegexNode::Kind;
+        if (code.size() - first > max_size) {
+            return; // add() reports it
+        }
+        switch (node.kind) {
+        case Kind::bytes:
+            sets.push_back(node.bytes);
+            push(Op::bytes, static_cast<std::uint32_t>(sets.size() - 1));
+            break;
+        case Kind::assertion:
+            push(Op::assertion, static_cast<std::uint32_t>(node.assertion));
+            break;
+        case Kind::concat:
+            for (const RegexNode& child : node.children) {
+                emit(child, first);
+            }
+            break;
+        case Kind::alternate: {
+            std::vector<std::size_t> exits;
+            for (std::size_t i = 0; i + 1 < node.children.size(); ++i) {
+                const std::size_t split = push(Op::split, here() + 1);
+                emit(node.children[i], first);
+                exits.push_back(push(Op::jump));
+                code[split].y = here();
+            }
+            emit(node.children.back(), first);
+            for (const std::size_t exit : exits) {
+                code[exit].x = here();
+            }
+            break;
+        }
+        case Kind::repeat: {
+            const RegexNode& child = node.children.front();
+            for (int i = 0; i < node.min; ++i) {
+                emit(child, first);
+            }
+            if (node.max < 0) {
+                const std::uint32_t loop = here();
+                const std::size_t split = push(Op::split, loop + 1);
+                emit(child, first);
+                push(Op::jump, loop);
+                code[split].y = here();
+                break;
+            }
+            std::vector<std::size_t> skips;
+            for (int i = node.min; i < node.max; ++i) {
+                skips.push_back(push(Op::split, here() + 1));
+                emit(child, first);
+            }
+            for (const std::size_t skip : skips) {
+                code[skip].y = here();
+            }
+            break;
+        }
+        }
+    }
+};
+
+// Aho-Corasick over bytes, with every transition filled in so a step is a
+// single table lookup. outputs[state] lists the words ending there,
+// including those reached through suffix links.
+struct AhoCorasick {
+    std::vector<std::array<std::uint32_t, 256>> next;
+    std::vector<std::vector<std::uint32_t>> outputs;
+
+    AhoCorasick() : next(1), outputs(1) {
+        next[0].fill(0);
+    }
+
+    void add(const std::string_view word, const std::uint32_t id) {
+        std::uint32_t state = 0;
+        for (const char ch : word) {
+            const auto c = static_cast<unsigned char>(ch);
+            if (next[state][c] == 0) {
+                next[state][c] = static_cast<std::uint32_t>(next.size());
+                next.emplace_back().fill(0);
+                outputs.emplace_back();
+            }
+            state = next[state][c];
+        }
+        outputs[state].push_back(id);
+    }
+
+    // turn the trie into the automaton; call once, after every add()
+    void build() {
+        std::vector<std::uint32_t> fail(next.size(), 0);
+        std::deque<std::uint32_t> queue;
+        for (const std::uint32_t child : next[0]) {
+            if (child != 0) {
+                queue.push_back(child);
+            }
+        }
+        while (!queue.empty()) {
+            const std::uint32_t state = queue.front();
+            queue.pop_front();
+            const auto& inherited = outputs[fail[state]];
+            outputs[state].insert(outputs[state].end(), inherited.begin(),
+                                  inherited.end());
+            for (unsigned c = 0; c < 256; ++c) {
+                const std::uint32_t child = next[state][c];
+                if (child != 0) {
+                    fail[child] = next[fail[state]][c];
+                    queue.push_back(child);
+                } else {
+                    next[state][c] = next[fail[state]][c];
+                }
+            }
+        }
+    }
+};
+
+} // namespace detail
+
+class PatternSet {
+public:
+    using size_type = std::size_t;
+
+    struct Match {
+        size_type pattern = 0; // index into the constructor's patterns
+        size_type offset = 0;
+        size_type length = 0;
+
+        bool operator==(const Match&) const = default;
+    };
+
+    // Throws std::invalid_argument for an empty literal or a malformed
+    // regex. maxLookahead is described at the top of this file.
+    explicit PatternSet(const std::vector<Pattern>& patterns,
+                        const size_type maxLookahead = default_regex_lookahead)
+        : maxLookahead(maxLookahead) {
+        for (size_type id = 0; id < patterns.size(); ++id) {
+            const Pattern& pattern = patterns[id];
+            kinds.push_back(pattern.kind);
+            if (pattern.kind == Pattern::Kind::regex) {
+                program.add(pattern.text);
+                regexIds.push_back(id);
+                continue;
+            }
+            if (pattern.text.empty()) {
+                throw std::invalid_argument("empty literal pattern");
+            }
+            literals.add(pattern.text,
+                         static_cast<std::uint32_t>(literalIds.size()));
+            literalIds.push_back(id);
+            literalLengths.push_back(pattern.text.size());
+        }
+        literals.build();
+    }
+
+    size_type size() const noexcept {
+        return kinds.size();
+    }
+
+    // Streaming state of one scan: feed() the text in order, in chunks of
+    // any size, then finish(). onMatch(Match) sees each match once it is
+    // certain, which for a regex may be some bytes after it ends, so
+    // matches do not arrive in offset order. A Scanner holds a copy of
+    // the bytes since the earliest pending regex match, and no others.
+    class Scanner {
+    public:
+        explicit Scanner(const PatternSet& set)
+            : set(&set), literalNext(set.literalIds.size(), 0),
+              regexes(set.regexIds.size()),
+              visited(set.program.code.size(), 0) {
+        }
+
+        size_type offset() const noexcept {
+            return position;
+        }
+
+        // bytes held for regexes to replay
+        size_type buffered() const noexcept {
+            return history.size();
+        }
+
+        template <typename OnMatch>
+        void feed(const std::string_view chunk, OnMatch&& onMatch) {
+            const auto& next = set->literals.next;
+            const auto& outputs = set->literals.outputs;
+            for (const char ch : chunk) {
+                const auto c = static_cast<unsigned char>(ch);
+                if (!regexes.empty()) {
+                    history.push_back(ch);
+                    if (busy > 0 || set->program.anyFirst.test(c)) {
+                        busy = 0;
+                        for (size_type r = 0; r < regexes.size(); ++r) {
+                            run(r, c, onMatch);
+                            busy += !regexes[r].idle();
+                        }
+                    }
+                    trim_history();
+                }
+                literalState = next[literalState][c];
+                for (const std::uint32_t literal : outputs[literalState]) {
+                    const size_type length = set->literalLengths[literal];
+                    if (position + 1 - length >= literalNext[literal]) {
+                        literalNext[literal] = position + 1;
+                        onMatch(Match{set->literalIds[literal],
+                                      position + 1 - length, length});
+                    }
+                }
+                previous = c;
+                ++position;
+            }
+        }
+
+        // end of text: report the matches still pending
+        template <typename OnMatch>
+        void finish(OnMatch&& onMatch) {
+            for (size_type r = 0; r < regexes.size(); ++r) {
+                run(r, -1, onMatch);
+            }
+        }
+
+    private:
+        struct Thread {
+            std::uint32_t pc;
+            size_type start;
+        };
+
+        // The best match so far is [start, end); it is reported once no
+        // thread starting at or before start is left, or maxLookahead
+        // bytes past end, whichever comes first. The regex then
+        // restarts at end, replaying the bytes it has seen since. An idle
+        // regex is not stepped until a byte it can start with comes by.
+        struct RegexState {
+            std::vector<Thread> threads; // sorted by start
+            size_type at = 0;            // offset the threads wait at
+            bool pending = false;
+            bool replaying = false;
+            size_type start = 0;
+            size_type end = 0;
+
+            bool idle() const noexcept {
+                return threads.empty() && !pending && !replaying;
+            }
+        };
+
+        int byte_at(const size_type offset) const {
+            return static_cast<unsigned char>(history[offset - historyBase]);
+        }
+
+        int byte_before(const size_type offset) const {
+            return offset == 0 ? -1 : byte_at(offset - 1);
+        }
+
+        // bring regex r up to position, whose byte is next (-1 at the end)
+        template <typename OnMatch>
+        void run(const size_type r, const int next, OnMatch& onMatch) {
+            RegexState& state = regexes[r];
+            if (state.idle()) {
+                if (next < 0 || !set->program.firsts[r].test(next)) {
+                    return;
+                }
+                state.at = position;
+            }
+            do {
+                while (state.at < position) {
+                    step(r, byte_before(state.at), byte_at(state.at),
+                         onMatch);
+                }
+                state.replaying = false;
+            } while (step(r, previous, next, onMatch));
+        }
+
+        // One Pike VM step of regex r at state.at: follow the threads and a
+        // new one through the non-consuming instructions, then consume next.
+        // Returns true when a match was reported and r restarted.
+        template <typename OnMatch>
+        bool step(const size_type r, const int prev, const int next,
+                  OnMatch& onMatch) {
+            RegexState& state = regexes[r];
+            ++generation;
+            closed.clear();
+            for (const Thread& thread : state.threads) {
+                close(state, thread, prev, next);
+            }
+            if (!state.pending) { // later starts cannot be leftmost
+                close(state, {set->program.starts[r], state.at}, prev, next);
+            }
+
+            state.threads.clear();
+            if (next >= 0) {
+                const detail::Program& program = set->program;
+                for (const Thread& thread : closed) {
+                    const detail::Instruction& in = program.code[thread.pc];
+                    if (program.sets[in.x].test(next) &&
+                        (!state.pending || thread.start <= state.start)) {
+                        state.threads.push_back({thread.pc + 1, thread.start});
+                    }
+                }
+                ++state.at;
+            }
+
+            if (state.pending &&
+                (state.threads.empty() ||
+                 state.threads.front().start > state.start ||
+                 state.at - state.end > set->maxLookahead)) {
+                onMatch(Match{set->regexIds[r], state.start,
+                              state.end - state.start});
+                state.pending = false;
+                state.threads.clear();
+                state.at = state.end;
+                state.replaying = true;
+                return true;
+            }
+            return false;
+        }
+
+        // add the thread and everything it reaches without consuming
+        void close(RegexState& state, const Thread& thread, const int prev,
+                   const int next) {
+            using Op = detail::Instruction::Op;
+            stack.push_back(thread.pc);
+            while (!stack.empty()) {
+                const std::uint32_t pc = stack.back();
+                stack.pop_back();
+                if (visited[pc] == generation) {
+                    continue; // an earlier start got here first
+                }
+                visited[pc] = generation;
+                const detail::Instruction& in = set->program.code[pc];
+                switch (in.op) {
+                case Op::bytes:
+                    closed.push_back({pc, thread.start});
+                    break;
+                case Op::split:
+                    stack.push_back(in.y);
+                    stack.push_back(in.x);
+                    break;
+                case Op::jump:
+                    stack.push_back(in.x);
+                    break;
+                case Op::assertion:
+                    if (holds(static_cast<detail::Assertion>(in.x), prev,
+                              next)) {
+                        stack.push_back(pc + 1);
+                    }
+                    break;
+                case Op::match:
+                    matched(state, thread.start);
+                    break;
+                }
+            }
+        }
+
+        static void matched(RegexState& state, const size_type start) {
+            const size_type end = state.at;
+            if (end == start) {
+                return;
+            }
+            if (!state.pending || start < state.start ||
+                (start == state.start && end > state.end)) {
+                state.pending = true;
+                state.start = start;
+                state.end = end;
+            }
+        }
+
+        static bool holds(const detail::Assertion assertion, const int prev,
+                          const int next) {
+            static const detail::ByteSet word = detail::word_bytes();
+            const bool wordBefore = prev >= 0 && word.test(prev);
+            const bool wordAfter = next >= 0 && word.test(next);
+            switch (assertion) {
+            case detail::Assertion::line_start:
+                return prev < 0 || prev == '\n';
+            case detail::Assertion::line_end:
+                return next < 0 || next == '\n';
+            case detail::Assertion::word_boundary:
+                return wordBefore != wordAfter;
+            case detail::Assertion::not_word_boundary:
+                return wordBefore == wordAfter;
+            }
+            return false;
+        }
+
+        // drop the bytes no regex can replay any more, keeping the one
+        // before for the assertions
+        void trim_history() {
+            if (history.size() < 4096) {
+                return;
+            }
+            size_type keep = position;
+            for (const RegexState& state : regexes) {
+                if (!state.idle()) {
+                    keep = std::min(keep,
+                                    state.pending ? state.end : state.at);
+                }
+            }
+            keep = keep > 0 ? keep - 1 : 0;
+            if (keep - historyBase >= history.size() / 2) {
+                history.erase(0, keep - historyBase);
+                historyBase = keep;
+            }
+        }
+
+        const PatternSet* set;
+        size_type position = 0;
+        int previous = -1; // byte before position, -1 at the start
+        std::uint32_t literalState = 0;
+        std::vector<size_type> literalNext; // first offset a match may use
+        std::vector<RegexState> regexes;
+        size_type busy = 0; // regexes that are not idle
+        std::string history; // bytes from historyBase to position
+        size_type historyBase = 0;
+        std::vector<Thread> closed;
+        std::vector<std::uint32_t> stack;
+        std::vector<std::uint64_t> visited;
+        std::uint64_t generation = 0;
+    };
+
+    // Call onMatch(Match) for every match in text or in a GapBuffer<char>
+    // (anything with segments()), in the order a Scanner confirms them,
+    // without collecting them
+    template <typename OnMatch>
+    void for_each_match(const std::string_view text, OnMatch&& onMatch) const {
+        scan(std::array<std::string_view, 1>{text}, onMatch);
+    }
+
+    template <typename Buffer, typename OnMatch>
+        requires requires(const Buffer& buffer) { buffer.segments(); }
+    void for_each_match(const Buffer& buffer, OnMatch&& onMatch) const {
+        scan(buffer.segments(), onMatch);
+    }
+
+    // All matches, ordered by offset, then pattern
+    std::vector<Match> find_all(const std::string_view text) const {
+        return collect(std::array<std::string_view, 1>{text});
+    }
+
+    template <typename Buffer>
+        requires requires(const Buffer& buffer) { buffer.segments(); }
+    std::vector<Match> find_all(const Buffer& buffer) const {
+        return collect(buffer.segments());
+    }
+
+private:
+    template <typename Chunks, typename OnMatch>
+    void scan(const Chunks& chunks, OnMatch& onMatch) const {
+        Scanner scanner(*this);
+        for (const auto chunk : chunks) {
+            scanner.feed(std::string_view(chunk.data(), chunk.size()),
+                         onMatch);
+        }
+        scanner.finish(onMatch);
+    }
+
+    template <typename Chunks>
+    std::vector<Match> collect(const Chunks& chunks) const {
+        const auto before = [](const Match& a, const Match& b) {
+            return a.offset != b.offset ? a.offset < b.offset
+                                        : a.pattern < b.pattern;
+        };
+        // Literal matches arrive by end offset, so each one is at most a
+        // few places out of order: insertion keeps them sorted cheaply.
+        // Regex matches can be held back for long, so they are sorted once.
+        std::vector<Match> literalMatches;
+        std::vector<Match> regexMatches;
+        auto add = [&](const Match& match) {
+            if (kinds[match.pattern] == Pattern::Kind::regex) {
+                regexMatches.push_back(match);
+                return;
+            }
+            literalMatches.push_back(match);
+            for (auto it = literalMatches.end() - 1;
+                 it != literalMatches.begin() && before(*it, *(it - 1));
+                 --it) {
+                std::iter_swap(it, it - 1);
+            }
+        };
+        scan(chunks, add);
+
+        if (regexMatches.empty()) {
+            return literalMatches;
+        }
+        std::sort(regexMatches.begin(), regexMatches.end(), before);
+        std::vector<Match> matches;
+        matches.reserve(literalMatches.size() + regexMatches.size());
+        std::merge(literalMatches.begin(), literalMatches.end(),
+                   regexMatches.begin(), regexMatches.end(),
+                   std::back_inserter(matches), before);
+        return matches;
+    }
+
+    std::vector<Pattern::Kind> kinds;
+    detail::AhoCorasick literals;
+    std::vector<size_type> literalIds; // pattern index of each literal
+    std::vector<size_type> literalLengths;
+    detail::Program program;
+    std::vector<size_type> regexIds; // pattern index of each regex
+    size_type maxLookahead;
+};
+
+} // namespace gb
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace gb {
+
+// Power-of-two size classes from min_block to max_block bytes, carved from
+// slabs and recycled through per-class free lists. Memory only goes back to
+// the system when the pool is destroyed, so thousands of short-lived small
+// buffers cost a handful of mallocs. Larger or over-aligned requests go
+// straight to operator new.
+//
+// A pool is not thread-safe: use one per thread (see thread_local_pool())
+// or per request, and let it outlive every buffer allocated from it.
+class BufferPool {
+public:
+    static constexpr std::size_t min_block = 64;
+    static constexpr std::size_t max_block = 64 * 1024;
+    static constexpr std::size_t slab_size = 256 * 1024;
+
+    BufferPool() = default;
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    ~BufferPool() {
+        for (void* slab : slabs) {
+            ::operator delete(slab, std::align_val_t{min_block});
+        }
+    }
+
+    void* allocate(const std::size_t bytes, const std::size_t alignment) {
+        if (bytes > max_block || alignment > min_block) {
+            return ::operator new(bytes, std::align_val_t{alignment});
+        }
+        const std::size_t index = size_class(bytes);
+        if (FreeBlock* block = freeLists[index]) {
+            freeLists[index] = block->next;
+            return block;
+        }
+
+        const std::size_t blockSize = min_block << index;
+        if (static_cast<std::size_t>(slabEnd - cursor) < blockSize) {
+            cursor = static_cast<char*>(
+                ::operator new(slab_size, std::align_val_t{min_block}));
+            slabEnd = cursor + slab_size;
+            slabs.push_back(cursor);
+        }
+        void* block = cursor;
+        cursor += blockSize;
+        return block;
+    }
+
+    void deallocate(void* p, const std::size_t bytes,
+                    const std::size_t alignment) noexcept {
+        if (bytes > max_block || alignment > min_block) {
+            ::operator delete(p, std::align_val_t{alignment});
+            return;
+        }
+        const std::size_t index = size_class(bytes);
+        freeLists[index] = new (p) FreeBlock{freeLists[index]};
+    }
+
+    std::size_t slab_count() const noexcept {
+        return slabs.size();
+    }
+
+    // default pool of PoolAllocator, one per thread
+    static BufferPool& thread_local_pool() {
+        thread_local BufferPool pool;
+        return pool;
+    }
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    static constexpr std::size_t class_count =
+        std::countr_zero(max_block) - std::countr_zero(min_block) + 1;
+
+    static std::size_t size_class(const std::size_t bytes) noexcept {
+        return std::bit_width(std::max(bytes, min_block) - 1) -
+               std::countr_zero(min_block);
+    }
+
+    std::array<FreeBlock*, class_count> freeLists{};
+    std::vector<void*> slabs;
+    char* cursor = nullptr;
+    char* slabEnd = nullptr;
+};
+
+// Stateful allocator drawing from a BufferPool (the calling thread's pool
+// unless one is given). Containers propagate it on copy, move and swap, so
+// storage is always returned to the pool it came from.
+template <typename T>
+class PoolAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    PoolAllocator() noexcept : pool(&BufferPool::thread_local_pool()) {
+    }
+
+    explicit PoolAllocator(BufferPool& source) noexcept : pool(&source) {
+    }
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>& other) noexcept : pool(other.pool) {
+    }
+
+    T* allocate(const std::size_t n) {
+        if (n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        return static_cast<T*>(pool->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, const std::size_t n) noexcept {
+        pool->deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    BufferPool* resource() const noexcept {
+        return pool;
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>& other) const noexcept {
+        return pool == other.pool;
+    }
+
+private:
+    template <typename>
+    friend class PoolAllocator;
+
+    BufferPool* pool;
+};
+
+} // namespace gb
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+namespace gb {
+
+// True when moving a T to new storage and destroying the original is the
+// same as copying its bytes. Holds for trivially copyable types; specialize
+// it for types such as a struct holding a std::unique_ptr that are safe to
+// move with memmove even though they are not trivially copyable. Never mark
+// a type that points into itself: a libstdc++ std::string keeps short text
+// in its own object, a std::list links to a sentinel inside it, and both
+// are left dangling by a memmove.
+template <typename T>
+struct is_trivially_relocatable
+    : std::bool_constant<std::is_trivially_copyable_v<T>> {};
+
+template <typename T>
+inline constexpr bool is_trivially_relocatable_v =
+    is_trivially_relocatable<T>::value;
+
+} // namespace gb
+
+namespace gb::detail {
+
+// Move count live elements from first into dest, leaving the source range
+// uninitialized. The ranges may overlap (in which case the overlapping part
+// of dest holds live source elements and everything else is raw storage).
+// One memmove for trivially relocatable T, otherwise move-construct and
+// destroy element by element, walking away from the overlap.
+template <typename T>
+void relocate(T* first, const std::size_t count, T* dest) noexcept {
+    static_assert(std::is_nothrow_move_constructible_v<T> ||
+                      is_trivially_relocatable_v<T>,
+                  "relocation must not fail halfway");
+    if (count == 0 || first == dest) {
+        return;
+    }
+    if constexpr (is_trivially_relocatable_v<T>) {
+        std::memmove(static_cast<void*>(dest), static_cast<const void*>(first),
+                     count * sizeof(T));
+    } else if (dest < first) {
+        for (std::size_t i = 0; i < count; ++i) {
+            std::construct_at(dest + i, std::move(first[i]));
+            std::destroy_at(first + i);
+        }
+    } else {
+        for (std::size_t i = count; i-- > 0;) {
+            std::construct_at(dest + i, std::move(first[i]));
+            std::destroy_at(first + i);
+        }
+    }
+}
+
+} // namespace gb::detail
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <ranges>
+#include <utility>
+
+// Segment-aware algorithms. A segmented iterator splits [first, last) into a
+// few contiguous runs through first.segments(last) (a range of spans), e.g.
+// the halves on either side of a GapBuffer's gap. The gb:: algorithms below
+// run the standard algorithm once per run over plain pointers, so the inner
+// loops never test for the gap and vectorize like loops over an array. Any
+// other iterator is passed to the standard algorithm unchanged.
+
+namespace gb {
+
+template <typename It>
+concept SegmentedIterator =
+    std::random_access_iterator<It> && requires(const It& it) {
+        { it.segments(it) } -> std::ranges::range;
+    };
+
+namespace detail {
+// Call f(begin, end) for each contiguous run of [first, last); stops and
+// returns false as soon as f does
+template <typename It, typename F>
+constexpr bool for_each_run(It first, It last, F&& f) {
+    if constexpr (SegmentedIterator<It>) {
+        for (const auto run : first.segments(last)) {
+            if (!run.empty() && !f(run.data(), run.data() + run.size())) {
+                return false;
+            }
+        }
+        return true;
+    } else {
+        return f(std::move(first), std::move(last));
+    }
+}
+
+// Write the run [first, last) to out through write(first, last, out), which
+// returns the output end like std::copy. A segmented out is split into its
+// own runs so both sides are plain pointers.
+template <typename It, typename Out, typename Write>
+constexpr Out write_run(It first, It last, Out out, Write& write) {
+    if constexpr (SegmentedIterator<Out> && std::forward_iterator<It>) {
+        const auto n = std::distance(first, last);
+        for_each_run(out, out + n, [&](auto runFirst, auto runLast) {
+            const It next = std::next(first, runLast - runFirst);
+            write(first, next, runFirst);
+            first = next;
+            return true;
+        });
+        return out + n;
+    } else {
+        return write(std::move(first), std::move(last), std::move(out));
+    }
+}
+} // namespace detail
+
+template <std::input_iterator It, typename F>
+constexpr F for_each(It first, It last, F f) {
+    detail::for_each_run(first, last, [&](auto runFirst, auto runLast) {
+        std::for_each(runFirst, runLast, std::ref(f));
+        return true;
+    });
+    return f;
+}
+
+template <std::input_iterator It, typename V>
+constexpr std::iter_difference_t<It> count(It first, It last, const V& value) {
+    std::iter_difference_t<It> n = 0;
+    detail::for_each_run(first, last, [&](auto runFirst, auto runLast) {
+        n += std::count(runFirst, runLast, value);
+        return true;
+    });
+    return n;
+}
+
+template <std::input_iterator It, typename Out>
+constexpr Out copy(It first, It last, Out out) {
+    auto write = [](auto runFirst, auto runLast, auto dest) {
+        return std::copy(runFirst, runLast, dest);
+    };
+    detail::for_each_run(first, last, [&](auto runFirst, auto runLast) {
+        out = detail::write_run(runFirst, runLast, std::move(out), write);
+        return true;
+    });
+    return out;
+}
+
+template <std::input_iterator It, typename Out, typename Op>
+constexpr Out transform(It first, It last, Out out, Op op) {
+    auto write = [&op](auto runFirst, auto runLast, auto dest) {
+        return std::transform(runFirst, runLast, dest, op);
+    };
+    detail::for_each_run(first, last, [&](auto runFirst, auto runLast) {
+        out = detail::write_run(runFirst, runLast, std::move(out), write);
+        return true;
+    });
+    return out;
+}
+
+template <std::input_iterator It1, std::input_iterator It2>
+constexpr bool equal(It1 first1, It1 last1, It2 first2) {
+    return detail::for_each_run(first1, last1, [&](auto runFirst,
+                                                   auto runLast) {
+        using Run = decltype(runFirst);
+        if constexpr (SegmentedIterator<It2> && std::forward_iterator<Run>) {
+            const auto n = std::distance(runFirst, runLast);
+            const bool same = detail::for_each_run(
+                first2, first2 + n, [&](auto otherFirst, auto otherLast) {
+                    const Run next =
+                        std::next(runFirst, otherLast - otherFirst);
+                    const bool runSame = std::equal(runFirst, next, otherFirst);
+                    runFirst = next;
+                    return runSame;
+                });
+            first2 += n;
+            return same;
+        } else {
+            const auto [mismatch, other] =
+                std::mismatch(runFirst, runLast, first2);
+            first2 = other;
+            return mismatch == runLast;
+        }
+    });
+}
+
+template <std::input_iterator It1, std::input_iterator It2>
+constexpr bool equal(It1 first1, It1 last1, It2 first2, It2 last2) {
+    if constexpr (std::sized_sentinel_for<It1, It1> &&
+                  std::sized_sentinel_for<It2, It2>) {
+        if (last1 - first1 != last2 - first2) {
+            return false;
+        }
+        return gb::equal(first1, last1, first2);
+    } else {
+        return std::equal(first1, last1, first2, last2);
+    }
+}
+
+} // namespace gb
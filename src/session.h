@@ -0,0 +1,235 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+// On-disk session of a GapBuffer: everything needed to carry on exactly
+// where the buffer left off, laid out so that loading is a few bulk copies
+// out of a read-only mapping. Sections follow the header in this order,
+// each starting at a multiple of 8 bytes:
+//
+//   content          prefix elements, then suffix elements
+//   line index       (bytes, newlines) of every block, two u64 each
+//   journal records  (offset, erased, inserted, data, group start), five
+//                    u64 each
+//   journal arena    elements
+//
+// Integers are in native byte order and elements are stored as their
+// bytes, so a session is for the machine (and element type) that wrote it.
+// The checksum covers the header and every section; a file that does not
+// match it is rejected as a whole.
+namespace gb::session {
+
+inline constexpr std::array<char, 8> magic = {'G', 'B', 'S', 'E',
+                                              'S', 'S', '0', '1'};
+inline constexpr std::uint32_t version = 1;
+
+enum Flags : std::uint32_t {
+    has_line_index = 1,
+    has_utf8_index = 2,
+    has_journal = 4,
+    journal_group_closed = 8,
+};
+
+inline constexpr std::size_t line_block_words = 2;
+inline constexpr std::size_t record_words = 5;
+
+struct Header {
+    std::array<char, 8> magic = session::magic;
+    std::uint32_t version = session::version;
+    std::uint32_t element_size = 0;
+    std::uint32_t flags = 0;
+    std::uint32_t reserved = 0;
+    std::uint64_t prefix = 0;   // elements before the gap
+    std::uint64_t suffix = 0;   // elements after it
+    std::uint64_t capacity = 0; // elements, gap included
+    std::uint64_t line_blocks = 0;
+    std::uint64_t journal_records = 0;
+    std::uint64_t journal_arena = 0; // elements
+    std::uint64_t journal_applied = 0;
+    std::uint64_t checksum = 0;
+};
+static_assert(sizeof(Header) % 8 == 0);
+
+constexpr std::uint64_t align8(const std::uint64_t bytes) noexcept {
+    return (bytes + 7) & ~std::uint64_t{7};
+}
+
+// Byte offset of every section and of the end of the file
+struct Layout {
+    std::uint64_t content;
+    std::uint64_t line_blocks;
+    std::uint64_t journal_records;
+    std::uint64_t journal_arena;
+    std::uint64_t end;
+};
+
+// The counts come from the file, so keep every product and sum far from
+// overflowing before trusting it
+inline std::uint64_t section_bytes(const std::uint64_t count,
+                                   const std::uint64_t size) {
+    constexpr std::uint64_t limit = std::uint64_t{1} << 56;
+    if (count > limit / size) {
+        throw std::runtime_error("session: section too large");
+    }
+    return count * size;
+}
+
+inline Layout layout(const Header& header) {
+    const std::uint64_t elements = header.prefix + header.suffix;
+    Layout at{};
+    at.content = sizeof(Header);
+    at.line_blocks = at.content + align8(section_bytes(
+                                      elements, header.element_size));
+    at.journal_records =
+        at.line_blocks +
+        section_bytes(header.line_blocks, line_block_words * 8);
+    at.journal_arena =
+        at.journal_records +
+        section_bytes(header.journal_records, record_words * 8);
+    at.end = at.journal_arena + align8(section_bytes(header.journal_arena,
+                                                     header.element_size));
+    return at;
+}
+
+// Four independent multiply-xor lanes over 32 byte blocks, folded at the
+// end. Chaining through seed lets a file be checked section by section.
+// Catches truncation and corruption, not tampering.
+inline std::uint64_t checksum(std::span<const std::byte> bytes,
+                              const std::uint64_t seed) noexcept {
+    constexpr std::uint64_t k = 0x9e3779b97f4a7c15;
+    const auto mix = [](std::uint64_t h, const std::uint64_t word) {
+        h = (h ^ word) * k;
+        return h ^ (h >> 29);
+    };
+    const auto load = [](const std::byte* p) {
+        std::uint64_t word;
+        std::memcpy(&word, p, sizeof(word));
+        return word;
+    };
+
+    std::array<std::uint64_t, 4> lane = {seed, seed + 1, seed + 2, seed + 3};
+    const std::byte* p = bytes.data();
+    std::size_t left = bytes.size();
+    for (; left >= 32; p += 32, left -= 32) {
+        for (std::size_t i = 0; i < 4; ++i) {
+            lane[i] = mix(lane[i], load(p + 8 * i));
+        }
+    }
+    std::uint64_t h = bytes.size();
+    for (const std::uint64_t l : lane) {
+        h = mix(h, l);
+    }
+    for (; left >= 8; p += 8, left -= 8) {
+        h = mix(h, load(p));
+    }
+    if (left > 0) {
+        std::uint64_t tail = 0;
+        std::memcpy(&tail, p, left);
+        h = mix(h, tail);
+    }
+    return mix(h, k);
+}
+
+// The sections of a session file, checked against its header
+struct Sections {
+    Header header;
+    std::span<const std::byte> prefix;
+    std::span<const std::byte> suffix;
+    std::span<const std::byte> line_blocks;
+    std::span<const std::byte> journal_records;
+    std::span<const std::byte> journal_arena;
+};
+
+// Checksum of the header (its checksum field as 0), then of the sections in
+// file order, the content as its two halves
+inline std::uint64_t checksum(const Sections& sections) noexcept {
+    Header header = sections.header;
+    header.checksum = 0;
+    std::uint64_t h = checksum(
+        std::as_bytes(std::span<const Header>(&header, 1)), 0);
+    h = checksum(sections.prefix, h);
+    h = checksum(sections.suffix, h);
+    h = checksum(sections.line_blocks, h);
+    h = checksum(sections.journal_records, h);
+    return checksum(sections.journal_arena, h);
+}
+
+// Most gap a session is restored with as it was saved: growth policies keep
+// a gap of a few times the content at most, so a larger one is a reserve
+// (or a damaged header) not worth allocating again, and load_session sizes
+// the buffer with its growth policy instead
+inline constexpr std::uint64_t max_gap_factor = 8;
+inline constexpr std::uint64_t max_gap_slack = std::uint64_t{1} << 24;
+
+inline bool keeps_capacity(const Header& header) noexcept {
+    const std::uint64_t content = header.prefix + header.suffix;
+    return header.capacity - content <=
+           max_gap_factor * content + max_gap_slack;
+}
+
+// The sections of file as its header places them, checked against the
+// file size only
+inline Sections locate(std::span<const std::byte> file,
+                       const std::size_t elementSize) {
+    Sections sections{};
+    Header& header = sections.header;
+    if (file.size() < sizeof(Header)) {
+        throw std::runtime_error("session: truncated header");
+    }
+    std::memcpy(&header, file.data(), sizeof(Header));
+    if (header.magic != magic) {
+        throw std::runtime_error("session: not a session file");
+    }
+    if (header.version != version) {
+        throw std::runtime_error("session: unsupported version " +
+                                 std::to_string(header.version));
+    }
+    if (header.element_size != elementSize) {
+        throw std::runtime_error("session: saved with another element type");
+    }
+    if (header.prefix > header.capacity ||
+        header.suffix > header.capacity - header.prefix ||
+        header.journal_applied > header.journal_records) {
+        throw std::runtime_error("session: inconsistent header");
+    }
+
+    const Layout at = layout(header);
+    if (at.end != file.size()) {
+        throw std::runtime_error("session: file is " +
+                                 std::to_string(file.size()) +
+                                 " bytes, header describes " +
+                                 std::to_string(at.end));
+    }
+    const auto section = [&](const std::uint64_t offset,
+                             const std::uint64_t bytes) {
+        return file.subspan(offset, bytes);
+    };
+    sections.prefix = section(at.content, header.prefix * elementSize);
+    sections.suffix = section(at.content + sections.prefix.size(),
+                              header.suffix * elementSize);
+    sections.line_blocks = section(at.line_blocks,
+                                   at.journal_records - at.line_blocks);
+    sections.journal_records = section(at.journal_records,
+                                       at.journal_arena - at.journal_records);
+    sections.journal_arena =
+        section(at.journal_arena, header.journal_arena * elementSize);
+    return sections;
+}
+
+// The sections of file once the checksum checks out
+inline Sections parse(std::span<const std::byte> file,
+                      const std::size_t elementSize) {
+    const Sections sections = locate(file, elementSize);
+    if (checksum(sections) != sections.header.checksum) {
+        throw std::runtime_error("session: checksum mismatch");
+    }
+    return sections;
+}
+
+} // namespace gb::session
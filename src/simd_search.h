@@ -0,0 +1,251 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Byte search kernels over one contiguous range. Each kernel is written once
+// against a "vector" of Width bytes and instantiated for the widest ISA the
+// translation unit is compiled for: AVX2 (-mavx2), SSE2 (baseline on x86-64)
+// or a one byte scalar fallback. All of them return `last` when nothing is
+// found.
+namespace gb::simd {
+
+struct Scalar {
+    static constexpr std::size_t width = 1;
+    using vector = char;
+
+    static vector splat(char c) {
+        return c;
+    }
+    static vector load(const char* p) {
+        return *p;
+    }
+    // bit i set when byte i of a equals byte i of b
+    static std::uint32_t match(vector a, vector b) {
+        return a == b;
+    }
+    // bit i set when byte i of a is less than byte i of b, as signed bytes
+    static std::uint32_t less(vector a, vector b) {
+        return static_cast<signed char>(a) < static_cast<signed char>(b);
+    }
+};
+
+#if defined(__SSE2__)
+struct Sse2 {
+    static constexpr std::size_t width = 16;
+    using vector = __m128i;
+
+    static vector splat(char c) {
+        return _mm_set1_epi8(c);
+    }
+    static vector load(const char* p) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    }
+    static std::uint32_t match(vector a, vector b) {
+        return static_cast<std::uint32_t>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(a, b)));
+    }
+    static std::uint32_t less(vector a, vector b) {
+        return static_cast<std::uint32_t>(
+            _mm_movemask_epi8(_mm_cmplt_epi8(a, b)));
+    }
+};
+#endif
+
+#if defined(__AVX2__)
+struct Avx2 {
+    static constexpr std::size_t width = 32;
+    using vector = __m256i;
+
+    static vector splat(char c) {
+        return _mm256_set1_epi8(c);
+    }
+    static vector load(const char* p) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    }
+    static std::uint32_t match(vector a, vector b) {
+        return static_cast<std::uint32_t>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)));
+    }
+    static std::uint32_t less(vector a, vector b) {
+        return static_cast<std::uint32_t>(
+            _mm256_movemask_epi8(_mm256_cmpgt_epi8(b, a)));
+    }
+};
+using Native = Avx2;
+#elif defined(__SSE2__)
+using Native = Sse2;
+#else
+using Native = Scalar;
+#endif
+
+template <typename V = Native>
+const char* find_byte(const char* first, const char* last, char c) {
+    const auto needle = V::splat(c);
+    for (; static_cast<std::size_t>(last - first) >= V::width;
+         first += V::width) {
+        if (const std::uint32_t mask = V::match(V::load(first), needle)) {
+            return first + std::countr_zero(mask);
+        }
+    }
+    for (; first != last; ++first) {
+        if (*first == c) {
+            return first;
+        }
+    }
+    return last;
+}
+
+template <typename V = Native>
+const char* rfind_byte(const char* first, const char* last, char c) {
+    const auto needle = V::splat(c);
+    const char* end = last;
+    for (; static_cast<std::size_t>(end - first) >= V::width; end -= V::width) {
+        const char* block = end - V::width;
+        if (const std::uint32_t mask = V::match(V::load(block), needle)) {
+            return block + (std::bit_width(mask) - 1);
+        }
+    }
+    while (end != first) {
+        if (*--end == c) {
+            return end;
+        }
+    }
+    return last;
+}
+
+template <typename V = Native>
+std::size_t count_byte(const char* first, const char* last, char c) {
+    const auto needle = V::splat(c);
+    std::size_t count = 0;
+    for (; static_cast<std::size_t>(last - first) >= V::width;
+         first += V::width) {
+        count += std::popcount(V::match(V::load(first), needle));
+    }
+    for (; first != last; ++first) {
+        count += (*first == c);
+    }
+    return count;
+}
+
+// Candidates are positions whose first and last needle bytes both match
+// (compared a whole vector at a time); only those get a memcmp.
+template <typename V = Native>
+const char* find_substr(const char* first, const char* last,
+                        const char* needle, std::size_t m) {
+    if (m == 0) {
+        return first;
+    }
+    if (static_cast<std::size_t>(last - first) < m) {
+        return last;
+    }
+    if (m == 1) {
+        return find_byte<V>(first, last, needle[0]);
+    }
+
+    const auto head = V::splat(needle[0]);
+    const auto tail = V::splat(needle[m - 1]);
+    const char* limit = last - m + 1; // one past the last candidate start
+    const char* pos = first;
+    for (; static_cast<std::size_t>(limit - pos) >= V::width;
+         pos += V::width) {
+        std::uint32_t mask = V::match(V::load(pos), head) &
+                             V::match(V::load(pos + m - 1), tail);
+        while (mask) {
+            const char* candidate = pos + std::countr_zero(mask);
+            if (std::memcmp(candidate + 1, needle + 1, m - 2) == 0) {
+                return candidate;
+            }
+            mask &= mask - 1;
+        }
+    }
+    for (; pos != limit; ++pos) {
+        if (pos[0] == needle[0] && std::memcmp(pos + 1, needle + 1, m - 1) == 0) {
+            return pos;
+        }
+    }
+    return last;
+}
+
+template <typename V = Native>
+const char* rfind_substr(const char* first, const char* last,
+                         const char* needle, std::size_t m) {
+    if (static_cast<std::size_t>(last - first) < m) {
+        return last;
+    }
+    if (m == 0) {
+        return last;
+    }
+    if (m == 1) {
+        return rfind_byte<V>(first, last, needle[0]);
+    }
+
+    const auto head = V::splat(needle[0]);
+    const auto tail = V::splat(needle[m - 1]);
+    const char* limit = last - m + 1;
+    for (; static_cast<std::size_t>(limit - first) >= V::width;
+         limit -= V::width) {
+        const char* block = limit - V::width;
+        std::uint32_t mask = V::match(V::load(block), head) &
+                             V::match(V::load(block + m - 1), tail);
+        while (mask) {
+            const int bit = std::bit_width(mask) - 1;
+            const char* candidate = block + bit;
+            if (std::memcmp(candidate + 1, needle + 1, m - 2) == 0) {
+                return candidate;
+            }
+            mask ^= std::uint32_t{1} << bit;
+        }
+    }
+    while (limit != first) {
+        --limit;
+        if (limit[0] == needle[0] &&
+            std::memcmp(limit + 1, needle + 1, m - 1) == 0) {
+            return limit;
+        }
+    }
+    return last;
+}
+
+// Length of the common prefix of a[0, n) and b[0, n)
+template <typename V = Native>
+std::size_t mismatch(const char* a, const char* b, const std::size_t n) {
+    std::size_t i = 0;
+    for (; n - i >= V::width; i += V::width) {
+        const int same =
+            std::countr_one(V::match(V::load(a + i), V::load(b + i)));
+        if (static_cast<std::size_t>(same) < V::width) {
+            return i + same;
+        }
+    }
+    while (i < n && a[i] == b[i]) {
+        ++i;
+    }
+    return i;
+}
+
+// Length of the common suffix of a[0, n) and b[0, n)
+template <typename V = Native>
+std::size_t rmismatch(const char* a, const char* b, const std::size_t n) {
+    std::size_t i = 0; // matching bytes at the end so far
+    for (; n - i >= V::width; i += V::width) {
+        const std::size_t at = n - i - V::width;
+        const std::uint32_t equal = V::match(V::load(a + at), V::load(b + at));
+        const int same = std::countl_one(equal << (32 - V::width));
+        if (static_cast<std::size_t>(same) < V::width) {
+            return i + same;
+        }
+    }
+    while (i < n && a[n - i - 1] == b[n - i - 1]) {
+        ++i;
+    }
+    return i;
+}
+
+} // namespace gb::simd
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Work-stealing pool for data-parallel loops. run(count, f) calls f(i) for
+// every i in [0, count) and returns when all calls are done. A loop starts
+// as one range task; whoever executes a range keeps its first half and
+// pushes the second to its own queue, so a worker ends up with ranges of
+// halving size. Idle workers steal from the front of other queues, where
+// the largest ranges are, and the calling thread helps until its loop is
+// finished. Items are meant to be coarse (tiles of a buffer): every queue
+// is a mutex-guarded deque.
+namespace gb {
+
+class ThreadPool {
+public:
+    // threads workers besides the threads calling run(); 0 runs every loop
+    // inline
+    explicit ThreadPool(const std::size_t threads) : queues(threads + 1) {
+        workers.reserve(threads);
+        for (std::size_t i = 0; i < threads; ++i) {
+            workers.emplace_back([this, i] { work(i); });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            const std::lock_guard lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // One worker per hardware thread beyond the caller's
+    static ThreadPool& shared() {
+        static ThreadPool pool(
+            std::max(std::thread::hardware_concurrency(), 1u) - 1);
+        return pool;
+    }
+
+    std::size_t size() const noexcept {
+        return workers.size();
+    }
+
+    // f(i) for every i in [0, count), concurrently. The first exception
+    // thrown by f is rethrown here once every call has returned or been
+    // skipped.
+    template <typename F>
+    void run(const std::size_t count, F&& f) {
+        if (count == 0) {
+            return;
+        }
+        if (workers.empty() || count == 1) {
+            for (std::size_t i = 0; i < count; ++i) {
+                f(i);
+            }
+            return;
+        }
+
+        Job job;
+        job.call = [](void* fn, std::size_t i) {
+            (*static_cast<std::remove_reference_t<F>*>(fn))(i);
+        };
+        job.fn = &f;
+        job.left.store(count, std::memory_order_relaxed);
+        push(shared_queue(), {&job, 0, count});
+
+        // Help while there are tasks; once the queues are empty the rest of
+        // the loop is in other threads' hands
+        Task task;
+        while (steal(shared_queue(), task)) {
+            execute(task, shared_queue());
+        }
+        {
+            std::unique_lock lock(job.doneMutex);
+            job.finished.wait(lock, [&job] { return job.done; });
+        }
+        if (job.error) {
+            std::rethrow_exception(job.error);
+        }
+    }
+
+private:
+    struct Job {
+        void (*call)(void*, std::size_t) = nullptr;
+        void* fn = nullptr;
+        std::atomic<std::size_t> left{0}; // items not yet done
+        std::atomic<bool> failed{false};
+        std::mutex errorMutex;
+        std::exception_ptr error;
+        // set under the mutex, so the job outlives its last notify
+        std::mutex doneMutex;
+        std::condition_variable finished;
+        bool done = false;
+    };
+
+    struct Task {
+        Job* job = nullptr;
+        std::size_t begin = 0;
+        std::size_t end = 0;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    // callers push to the queue after the workers' own ones
+    std::size_t shared_queue() const noexcept {
+        return workers.size();
+    }
+
+    // queued is raised first, so it never counts fewer tasks than there are
+    void push(const std::size_t queue, const Task& task) {
+        {
+            const std::lock_guard lock(sleepMutex);
+            ++queued;
+        }
+        {
+            const std::lock_guard lock(queues[queue].mutex);
+            queues[queue].tasks.push_back(task);
+        }
+        wake.notify_one();
+    }
+
+    // the newest task of queue home, else the oldest of any other queue
+    bool steal(const std::size_t home, Task& task) {
+        if (queued.load(std::memory_order_relaxed) == 0) {
+            return false;
+        }
+        for (std::size_t n = 0; n < queues.size(); ++n) {
+            const std::size_t i = (home + n) % queues.size();
+            const std::lock_guard lock(queues[i].mutex);
+            if (queues[i].tasks.empty()) {
+                continue;
+            }
+            if (i == home) {
+                task = queues[i].tasks.back();
+                queues[i].tasks.pop_back();
+            } else {
+                task = queues[i].tasks.front();
+                queues[i].tasks.pop_front();
+            }
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    // Run the first item of task, after pushing the rest in halves
+    void execute(Task task, const std::size_t home) {
+        while (task.end - task.begin > 1) {
+            const std::size_t mid = task.begin + (task.end - task.begin) / 2;
+            push(home, {task.job, mid, task.end});
+            task.end = mid;
+        }
+
+        Job& job = *task.job;
+        if (!job.failed.load(std::memory_order_relaxed)) {
+            try {
+                job.call(job.fn, task.begin);
+            } catch (...) {
+                const std::lock_guard lock(job.errorMutex);
+                if (!job.error) {
+                    job.error = std::current_exception();
+                }
+                job.failed.store(true, std::memory_order_relaxed);
+            }
+        }
+        if (job.left.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            const std::lock_guard lock(job.doneMutex);
+            job.done = true;
+            job.finished.notify_all();
+        }
+    }
+
+    void work(const std::size_t home) {
+        while (true) {
+            Task task;
+            if (steal(home, task)) {
+                execute(task, home);
+                continue;
+            }
+            std::unique_lock lock(sleepMutex);
+            wake.wait(lock, [this] { return stopping || queued > 0; });
+            if (stopping) {
+                return;
+            }
+        }
+    }
+
+    std::vector<Queue> queues; // one per worker, then the callers'
+    std::vector<std::thread> workers;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<std::size_t> queued{0}; // tasks in all queues
+    bool stopping = false;
+};
+
+} // namespace gb
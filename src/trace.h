@@ -0,0 +1,526 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "gapbuffer.h"
+
+// Recorded editing traces, as replayed by gbreplay. Two on-disk formats:
+//
+//   JSON  the format of the public editing-traces datasets:
+//         {"startContent": "...", "endContent": "...",
+//          "txns": [{"patches": [[pos, deleted, "inserted"], ...]}, ...]}
+//         or a flat {"edits": [[pos, deleted, "inserted"], ...]}. Positions
+//         and deletion lengths count Unicode code points; patches apply in
+//         order, each to the result of the previous one.
+//   binary "GBTRACE1", then start content, a flag and end content, the op
+//         count and every op as (pos, erase, length, bytes). Integers are
+//         64 bit in native byte order; positions are already byte offsets.
+//
+// Both load into a Trace whose ops address bytes, so every backend replays
+// exactly the same operations.
+namespace gb::trace {
+
+struct Op {
+    std::size_t pos = 0;
+    std::size_t erase = 0;
+    std::string text;
+
+    bool operator==(const Op&) const = default;
+};
+
+struct Trace {
+    std::string start;
+    std::optional<std::string> end; // expected final content, if recorded
+    std::vector<Op> ops;
+};
+
+// 64 bit FNV-1a, fed one contiguous run at a time
+class Fnv1a {
+public:
+    void update(std::span<const char> bytes) noexcept {
+        for (const char c : bytes) {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+        }
+    }
+
+    std::uint64_t digest() const noexcept {
+        return hash;
+    }
+
+private:
+    std::uint64_t hash = 14695981039346656037ull;
+};
+
+namespace detail {
+
+// Just enough JSON for trace files: a DOM of nulls, booleans, numbers,
+// strings (decoded to UTF-8), arrays and objects
+struct Json {
+    enum class Kind { Null, Bool, Number, String, Array, Object };
+
+    Kind kind = Kind::Null;
+    double number = 0;
+    std::string string;
+    std::vector<Json> items;
+    std::vector<std::pair<std::string, Json>> members;
+
+    const Json* find(std::string_view key) const {
+        for (const auto& [name, value] : members) {
+            if (name == key) {
+                return &value;
+            }
+        }
+        return nullptr;
+    }
+};
+
+class JsonParser {
+public:
+    explicit JsonParser(std::string_view input) : text(input) {
+    }
+
+    Json parse() {
+        Json value = parse_value(0);
+        skip_space();
+        if (pos != text.size()) {
+            fail("trailing characters");
+        }
+        return value;
+    }
+
+private:
+    static constexpr int max_depth = 64;
+
+    [[noreturn]] void fail(const std::string& what) const {
+        throw std::runtime_error("trace: " + what + " at byte " +
+                                 std::to_string(pos));
+    }
+
+    void skip_space() {
+        while (pos < text.size() &&
+               (text[pos] == ' ' || text[pos] == '\n' || text[pos] == '\r' ||
+                text[pos] == '\t')) {
+            ++pos;
+        }
+    }
+
+    void expect(const char c) {
+        skip_space();
+        if (pos >= text.size() || text[pos] != c) {
+            fail(std::string("expected '") + c + "'");
+        }
+        ++pos;
+    }
+
+    bool consume(std::string_view word) {
+        if (text.substr(pos, word.size()) == word) {
+            pos += word.size();
+            return true;
+        }
+        return false;
+    }
+
+    Json parse_value(const int depth) {
+        if (depth > max_depth) {
+            fail("nesting too deep");
+        }
+        skip_space();
+        if (pos >= text.size()) {
+            fail("unexpected end");
+        }
+        Json value;
+        switch (text[pos]) {
+        case '{':
+            value.kind = Json::Kind::Object;
+            ++pos;
+            skip_space();
+            if (pos < text.size() && text[pos] == '}') {
+                ++pos;
+                return value;
+            }
+            do {
+                skip_space();
+                std::string key = parse_string();
+                expect(':');
+                value.members.emplace_back(std::move(key),
+                                           parse_value(depth + 1));
+                skip_space();
+            } while (consume(","));
+            expect('}');
+            return value;
+        case '[':
+            value.kind = Json::Kind::Array;
+            ++pos;
+            skip_space();
+            if (pos < text.size() && text[pos] == ']') {
+                ++pos;
+                return value;
+            }
+            do {
+                value.items.push_back(parse_value(depth + 1));
+                skip_space();
+            } while (consume(","));
+            expect(']');
+            return value;
+        case '"':
+            value.kind = Json::Kind::String;
+            value.string = parse_string();
+            return value;
+        default:
+            if (consume("null")) {
+                return value;
+            }
+            if (consume("true")) {
+                value.kind = Json::Kind::Bool;
+                value.number = 1;
+                return value;
+            }
+            if (consume("false")) {
+                value.kind = Json::Kind::Bool;
+                return value;
+            }
+            value.kind = Json::Kind::Number;
+            value.number = parse_number();
+            return value;
+        }
+    }
+
+    double parse_number() {
+        const std::size_t begin = pos;
+        while (pos < text.size() &&
+               std::string_view("+-0123456789.eE").find(text[pos]) !=
+                   std::string_view::npos) {
+            ++pos;
+        }
+        if (pos == begin) {
+            fail("unexpected character");
+        }
+        try {
+            return std::stod(std::string(text.substr(begin, pos - begin)));
+        } catch (const std::logic_error&) {
+            fail("bad number");
+        }
+    }
+
+    unsigned parse_hex4() {
+        if (text.size() - pos < 4) {
+            fail("truncated \\u escape");
+        }
+        unsigned value = 0;
+        for (int i = 0; i < 4; ++i) {
+            const char c = text[pos++];
+            value <<= 4;
+            if (c >= '0' && c <= '9') {
+                value |= c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                value |= c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                value |= c - 'A' + 10;
+            } else {
+                fail("bad \\u escape");
+            }
+        }
+        return value;
+    }
+
+    static void append_utf8(std::string& out, const char32_t cp) {
+        if (cp < 0x80) {
+            out += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            out += static_cast<char>(0xC0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += static_cast<char>(0xE0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    std::string parse_string() {
+        if (pos >= text.size() || text[pos] != '"') {
+            fail("expected string");
+        }
+        ++pos;
+        std::string out;
+        while (true) {
+            const std::size_t run = text.find_first_of("\"\\", pos);
+            if (run == std::string_view::npos) {
+                fail("unterminated string");
+            }
+            out.append(text.substr(pos, run - pos));
+            pos = run + 1;
+            if (text[run] == '"') {
+                return out;
+            }
+            if (pos >= text.size()) {
+                fail("unterminated string");
+            }
+            switch (const char c = text[pos++]) {
+            case 'b':
+                out += '\b';
+                break;
+            case 'f':
+                out += '\f';
+                break;
+            case 'n':
+                out += '\n';
+                break;
+            case 'r':
+                out += '\r';
+                break;
+            case 't':
+                out += '\t';
+                break;
+            case 'u': {
+                char32_t cp = parse_hex4();
+                if (cp >= 0xD800 && cp <= 0xDBFF && consume("\\u")) {
+                    const char32_t low = parse_hex4();
+                    if (low < 0xDC00 || low > 0xDFFF) {
+                        fail("unpaired surrogate");
+                    }
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                } else if (cp >= 0xD800 && cp <= 0xDFFF) {
+                    fail("unpaired surrogate");
+                }
+                append_utf8(out, cp);
+                break;
+            }
+            default:
+                out += c; // \" \\ \/
+            }
+        }
+    }
+
+    std::string_view text;
+    std::size_t pos = 0;
+};
+
+inline std::string read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("trace: cannot open " + path);
+    }
+    return std::string(std::istreambuf_iterator<char>(in), {});
+}
+
+inline std::size_t to_size(const Json& value) {
+    if (value.kind != Json::Kind::Number || value.number < 0) {
+        throw std::runtime_error("trace: expected a non-negative number");
+    }
+    return static_cast<std::size_t>(value.number);
+}
+
+inline void append_patches(const Json& patches, std::vector<Op>& ops) {
+    if (patches.kind != Json::Kind::Array) {
+        throw std::runtime_error("trace: patches must be an array");
+    }
+    for (const Json& patch : patches.items) {
+        if (patch.kind != Json::Kind::Array || patch.items.size() != 3 ||
+            patch.items[2].kind != Json::Kind::String) {
+            throw std::runtime_error(
+                "trace: a patch is [position, deleted, \"inserted\"]");
+        }
+        ops.push_back({to_size(patch.items[0]), to_size(patch.items[1]),
+                       patch.items[2].string});
+    }
+}
+
+inline bool is_ascii(std::string_view s) {
+    for (const char c : s) {
+        if (static_cast<unsigned char>(c) >= 0x80) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Rewrite code point positions as byte offsets by replaying the trace once
+// against a GapBuffer in UTF-8 mode
+inline void to_byte_offsets(Trace& trace) {
+    GapBuffer<char> doc(std::string_view(trace.start));
+    doc.enable_utf8_index();
+    for (Op& op : trace.ops) {
+        if (op.pos > doc.code_point_count() ||
+            op.erase > doc.code_point_count() - op.pos) {
+            throw std::runtime_error("trace: edit past the end of the text");
+        }
+        const std::size_t from = doc.code_point_to_offset(op.pos);
+        const std::size_t to = doc.code_point_to_offset(op.pos + op.erase);
+        op.pos = from;
+        op.erase = to - from;
+        doc.erase(doc.begin() + from, doc.begin() + to);
+        doc.insert(doc.begin() + from, std::string_view(op.text));
+    }
+}
+
+// Follow the length of the text through byte offset ops, so a replay never
+// edits past its end
+inline void check_bounds(const Trace& trace) {
+    std::size_t length = trace.start.size();
+    for (const Op& op : trace.ops) {
+        if (op.pos > length || op.erase > length - op.pos) {
+            throw std::runtime_error("trace: edit past the end of the text");
+        }
+        length = length - op.erase + op.text.size();
+    }
+}
+
+template <typename V>
+void write_pod(std::string& out, const V value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+inline void write_bytes(std::string& out, std::string_view bytes) {
+    write_pod<std::uint64_t>(out, bytes.size());
+    out.append(bytes);
+}
+
+class BinaryReader {
+public:
+    explicit BinaryReader(std::string_view input) : data(input) {
+    }
+
+    std::uint64_t u64() {
+        std::uint64_t value;
+        std::memcpy(&value, take(sizeof(value)).data(), sizeof(value));
+        return value;
+    }
+
+    std::string_view take(const std::size_t count) {
+        if (count > data.size()) {
+            throw std::runtime_error("trace: truncated binary trace");
+        }
+        const std::string_view bytes = data.substr(0, count);
+        data.remove_prefix(count);
+        return bytes;
+    }
+
+    std::string bytes() {
+        return std::string(take(u64()));
+    }
+
+    bool done() const {
+        return data.empty();
+    }
+
+private:
+    std::string_view data;
+};
+
+} // namespace detail
+
+inline constexpr std::string_view binary_magic = "GBTRACE1";
+
+inline Trace parse_json(std::string_view json) {
+    using detail::Json;
+    const Json root = detail::JsonParser(json).parse();
+    if (root.kind != Json::Kind::Object) {
+        throw std::runtime_error("trace: top level must be an object");
+    }
+
+    Trace trace;
+    if (const Json* start = root.find("startContent")) {
+        trace.start = start->string;
+    }
+    if (const Json* end = root.find("endContent")) {
+        trace.end = end->string;
+    }
+    if (const Json* txns = root.find("txns")) {
+        for (const Json& txn : txns->items) {
+            if (const Json* patches = txn.find("patches")) {
+                detail::append_patches(*patches, trace.ops);
+            }
+        }
+    } else if (const Json* edits = root.find("edits")) {
+        detail::append_patches(*edits, trace.ops);
+    } else {
+        throw std::runtime_error("trace: no \"txns\" or \"edits\" found");
+    }
+
+    bool ascii = detail::is_ascii(trace.start);
+    for (const Op& op : trace.ops) {
+        ascii = ascii && detail::is_ascii(op.text);
+    }
+    if (ascii) {
+        detail::check_bounds(trace);
+    } else {
+        detail::to_byte_offsets(trace);
+    }
+    return trace;
+}
+
+inline Trace parse_binary(std::string_view data) {
+    detail::BinaryReader in(data);
+    if (in.take(binary_magic.size()) != binary_magic) {
+        throw std::runtime_error("trace: not a binary trace");
+    }
+    Trace trace;
+    trace.start = in.bytes();
+    if (in.u64() != 0) {
+        trace.end = in.bytes();
+    }
+    const std::uint64_t count = in.u64();
+    for (std::uint64_t i = 0; i < count; ++i) {
+        Op op;
+        op.pos = in.u64();
+        op.erase = in.u64();
+        op.text = in.bytes();
+        trace.ops.push_back(std::move(op));
+    }
+    if (!in.done()) {
+        throw std::runtime_error("trace: trailing bytes in binary trace");
+    }
+    detail::check_bounds(trace);
+    return trace;
+}
+
+inline std::string to_binary(const Trace& trace) {
+    std::string out(binary_magic);
+    detail::write_bytes(out, trace.start);
+    detail::write_pod<std::uint64_t>(out, trace.end.has_value());
+    if (trace.end) {
+        detail::write_bytes(out, *trace.end);
+    }
+    detail::write_pod<std::uint64_t>(out, trace.ops.size());
+    for (const Op& op : trace.ops) {
+        detail::write_pod<std::uint64_t>(out, op.pos);
+        detail::write_pod<std::uint64_t>(out, op.erase);
+        detail::write_bytes(out, op.text);
+    }
+    return out;
+}
+
+// Binary when the file starts with the magic, JSON otherwise
+inline Trace load(const std::string& path) {
+    const std::string data = detail::read_file(path);
+    if (data.starts_with(binary_magic)) {
+        return parse_binary(data);
+    }
+    return parse_json(data);
+}
+
+inline void save_binary(const Trace& trace, const std::string& path) {
+    const std::string data = to_binary(trace);
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.write(data.data(), static_cast<std::streamsize>(data.size()))) {
+        throw std::runtime_error("trace: cannot write " + path);
+    }
+}
+
+} // namespace gb::trace
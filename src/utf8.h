@@ -0,0 +1,125 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+#include "simd_search.h"
+
+// UTF-8 kernels over one contiguous range, built on the gb::simd vector
+// types: validation with an ASCII fast path, and code point / UTF-16 unit
+// counting. Counts only look at single bytes (a code point is a byte that
+// is not a continuation byte, a 4 byte lead adds a second UTF-16 unit), so
+// the counts of adjacent ranges add up wherever the ranges are split.
+namespace gb::utf8 {
+
+struct Counts {
+    std::size_t code_points = 0;
+    std::size_t utf16_units = 0;
+
+    Counts& operator+=(const Counts& other) noexcept {
+        code_points += other.code_points;
+        utf16_units += other.utf16_units;
+        return *this;
+    }
+
+    Counts& operator-=(const Counts& other) noexcept {
+        code_points -= other.code_points;
+        utf16_units -= other.utf16_units;
+        return *this;
+    }
+
+    bool operator==(const Counts&) const = default;
+};
+
+inline bool is_continuation(const char c) noexcept {
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+// UTF-16 units of the code point led by c (0 for a continuation byte)
+inline std::size_t utf16_units(const char c) noexcept {
+    if (is_continuation(c)) {
+        return 0;
+    }
+    return static_cast<unsigned char>(c) >= 0xF0 ? 2 : 1;
+}
+
+template <typename V = simd::Native>
+Counts count(const char* first, const char* last) {
+    // as signed bytes, continuation bytes are [-128, -65) and 4 byte leads
+    // [-16, 0)
+    const auto continuationEnd = V::splat(static_cast<char>(0xC0));
+    const auto beforeFourByte = V::splat(static_cast<char>(0xEF));
+    const auto zero = V::splat(0);
+    Counts counts;
+    for (; static_cast<std::size_t>(last - first) >= V::width;
+         first += V::width) {
+        const auto v = V::load(first);
+        const std::size_t leads =
+            V::width - std::popcount(V::less(v, continuationEnd));
+        const std::size_t fourByte =
+            std::popcount(V::less(beforeFourByte, v) & V::less(v, zero));
+        counts.code_points += leads;
+        counts.utf16_units += leads + fourByte;
+    }
+    for (; first != last; ++first) {
+        counts.code_points += !is_continuation(*first);
+        counts.utf16_units += utf16_units(*first);
+    }
+    return counts;
+}
+
+// First byte of the first ill-formed sequence (overlong forms, surrogates
+// and code points above U+10FFFF included), or last when the range is valid
+// UTF-8. A sequence cut off by last is ill-formed.
+template <typename V = simd::Native>
+const char* validate(const char* first, const char* last) {
+    const auto zero = V::splat(0);
+    while (first != last) {
+        if (static_cast<std::size_t>(last - first) >= V::width &&
+            V::less(V::load(first), zero) == 0) {
+            first += V::width; // all ASCII
+            continue;
+        }
+
+        const auto lead = static_cast<unsigned char>(*first);
+        if (lead < 0x80) {
+            ++first;
+            continue;
+        }
+        // Table 3-7 of the Unicode standard: the lead fixes the length and
+        // the range of the second byte
+        std::size_t length = 0;
+        unsigned char low = 0x80;
+        unsigned char high = 0xBF;
+        if (lead >= 0xC2 && lead <= 0xDF) {
+            length = 2;
+        } else if (lead >= 0xE0 && lead <= 0xEF) {
+            length = 3;
+            low = (lead == 0xE0) ? 0xA0 : 0x80;
+            high = (lead == 0xED) ? 0x9F : 0xBF;
+        } else if (lead >= 0xF0 && lead <= 0xF4) {
+            length = 4;
+            low = (lead == 0xF0) ? 0x90 : 0x80;
+            high = (lead == 0xF4) ? 0x8F : 0xBF;
+        } else {
+            return first;
+        }
+        if (static_cast<std::size_t>(last - first) < length) {
+            return first;
+        }
+        const auto second = static_cast<unsigned char>(first[1]);
+        if (second < low || second > high) {
+            return first;
+        }
+        for (std::size_t i = 2; i < length; ++i) {
+            if (!is_continuation(first[i])) {
+                return first;
+            }
+        }
+        first += length;
+    }
+    return last;
+}
+
+} // namespace gb::utf8
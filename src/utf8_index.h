@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+
+#include "block_count_index.h"
+#include "utf8.h"
+
+struct Utf8Counter {
+    using units_type = gb::utf8::Counts;
+    static constexpr std::size_t fields = 2; // code points, UTF-16 units
+
+    static std::size_t field(const units_type& counts, const std::size_t i) {
+        return i == 0 ? counts.code_points : counts.utf16_units;
+    }
+};
+
+// Code point and UTF-16 unit counts per block of UTF-8 text (see
+// BlockCountIndex). Counts add up across any byte split (see utf8.h), so
+// blocks need not end on code point boundaries.
+class Utf8Index : public BlockCountIndex<Utf8Counter> {
+public:
+    using Counts = gb::utf8::Counts;
+    using BlockCountIndex::BlockCountIndex;
+
+    Counts totals() const {
+        return {total(0), total(1)};
+    }
+
+    // Start offset of the block holding the n-th code point (0 based), and
+    // that code point's rank among the code points starting in the block
+    std::pair<size_type, size_type>
+    locate_code_point(const size_type n) const {
+        if (n >= total(0)) {
+            throw std::out_of_range("code point out of range");
+        }
+        return locate_unit(0, n);
+    }
+
+    // Start offset of the block holding the n-th UTF-16 unit (0 based), and
+    // the number of units before it that belong to the block
+    std::pair<size_type, size_type> locate_utf16(const size_type n) const {
+        if (n >= total(1)) {
+            throw std::out_of_range("UTF-16 offset out of range");
+        }
+        return locate_unit(1, n);
+    }
+
+    // Start offset of the block holding offset, and the counts before that
+    // block
+    std::pair<size_type, Counts> locate_offset(const size_type offset) const {
+        const auto [index, start] = block_at(offset);
+        return {start, {units_before(0, index), units_before(1, index)}};
+    }
+};